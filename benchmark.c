@@ -0,0 +1,291 @@
+/**
+    @filename benchmark.c
+    @author Will Greene (wgreene)
+
+    Benchmark harness. Times reading lines, loading the menu, and each kind of
+    command in a trace ( from gentrace ) separately, and prints the results as
+    JSON: throughput for every phase, and percentile latencies for commands.
+
+    usage: benchmark <trace-file> <menu-file>+
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "input.h"
+#include "menu.h"
+#include "order.h"
+#include "reload.h"
+#include "command.h"
+
+/** kinds of command timed separately */
+enum CommandKind {
+    LIST_MENU,
+    LIST_CATEGORY,
+    LIST_ORDER,
+    ADD,
+    REMOVE,
+    OTHER,
+    KIND_COUNT
+};
+
+/** names of the command kinds in the report */
+static char const *kindNames[ KIND_COUNT ] = {
+    "list menu", "list category", "list order", "add", "remove", "other",
+};
+
+/** initial capacity of each latency list */
+#define LATENCY_INITIAL_CAPACITY 1024
+
+/** nanoseconds in a second */
+#define NANOS_PER_SECOND 1000000000LL
+
+/** nanoseconds in a microsecond */
+#define NANOS_PER_MICRO 1000.0
+
+/**
+    Latencies of one kind of command.
+  */
+struct Latencies {
+    long long *nanos; // latency of each command
+    int count;        // number of commands
+    int capacity;     // capacity of the list
+};
+
+/**
+    Reads the monotonic clock.
+
+    @return the time in nanoseconds
+  */
+static long long now() {
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * NANOS_PER_SECOND + ts.tv_nsec;
+}
+
+/**
+    Works out which kind of command a line is.
+
+    @param *line command line
+    @return its kind
+  */
+static enum CommandKind classify( char const *line ) {
+
+    if ( strncmp( line, "list menu", 9 ) == 0 )
+        return LIST_MENU;
+    if ( strncmp( line, "list category", 13 ) == 0 )
+        return LIST_CATEGORY;
+    if ( strncmp( line, "list order", 10 ) == 0 )
+        return LIST_ORDER;
+    if ( strncmp( line, "add", 3 ) == 0 )
+        return ADD;
+    if ( strncmp( line, "remove", 6 ) == 0 )
+        return REMOVE;
+    return OTHER;
+}
+
+/**
+    Compares 2 latencies for qsort().
+
+    @param *aptr pointer to the first latency
+    @param *bptr pointer to the second latency
+    @return a negative number, 0 or a positive number as *a is less than,
+            equal to or greater than *b
+  */
+static int compareNanos( void const *aptr, void const *bptr ) {
+
+    long long a = *( long long const * ) aptr;
+    long long b = *( long long const * ) bptr;
+    return ( a > b ) - ( a < b );
+}
+
+/**
+    Picks a percentile from a sorted latency list.
+
+    @param *list sorted latencies
+    @param percent percentile to pick ( 0 to 100 )
+    @return the latency in microseconds
+  */
+static double percentile( struct Latencies const *list, double percent ) {
+
+    int i = (int) ( percent / 100.0 * ( list->count - 1 ) + 0.5 );
+    return list->nanos[ i ] / NANOS_PER_MICRO;
+}
+
+/**
+    Prints the JSON for a phase that was timed as a whole.
+
+    @param *name name of the phase
+    @param nanos how long it took
+    @param units how many units of work it did
+    @param *unitName what the units are
+    @param last true if this is the last phase printed
+  */
+static void printPhase( char const *name, long long nanos, long long units,
+                        char const *unitName, bool last ) {
+
+    double seconds = (double) nanos / NANOS_PER_SECOND;
+
+    printf( "    \"%s\": { \"seconds\": %.6f, \"%s\": %lld, \"%sPerSecond\": %.1f }%s\n",
+            name, seconds, unitName, units, unitName, seconds > 0 ? units / seconds : 0.0,
+            last ? "" : "," );
+}
+
+/**
+    Starting point. Runs the benchmark and prints the report.
+
+    @param argc number of arguments
+    @param *argv[] array of pointers to command line arguments
+    @return exit status
+  */
+int main( int argc, char *argv[] ) {
+
+    if ( argc < 3 ) {
+        fprintf( stderr, "usage: benchmark <trace-file> <menu-file>+\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    // reading lines: the whole trace, through the same reader the kiosk uses
+    int fd = open( argv[ 1 ], O_RDONLY );
+    if ( fd < 0 ) {
+        fprintf( stderr, "Can't open file: %s\n", argv[ 1 ] );
+        exit( EXIT_FAILURE );
+    }
+
+    char **lines = NULL;
+    int *lengths = NULL;
+    int lineCount = 0;
+    int lineCapacity = 0;
+    long long bytes = 0;
+
+    struct LineReader *reader = makeLineReader( fd );
+    char *line = NULL;
+    int capacity = 0;
+    int length;
+
+    long long start = now();
+    while ( ( length = getLine( reader, &line, &capacity ) ) >= 0 ) {
+
+        if ( lineCount >= lineCapacity ) {
+            lineCapacity = lineCapacity ? lineCapacity * 2 : LATENCY_INITIAL_CAPACITY;
+            lines = (char **) realloc( lines, lineCapacity * sizeof( char * ) );
+            lengths = (int *) realloc( lengths, lineCapacity * sizeof( int ) );
+        }
+
+        lines[ lineCount ] = strdup( line );
+        lengths[ lineCount++ ] = length;
+        bytes += length + 1;
+    }
+    long long readNanos = now() - start;
+
+    free( line );
+    freeLineReader( reader );
+    close( fd );
+
+    // loading: parsing, indexing and sorting the menu
+    struct Menu *menu = makeMenu();
+    int bad;
+
+    start = now();
+    int status = readMenuFiles( argv + 2, argc - 2, menu, &bad, true );
+    if ( status == MENU_OK )
+        sortMenuItems( menu );
+    long long loadNanos = now() - start;
+
+    if ( status != MENU_OK ) {
+        fprintf( stderr, status == MENU_CANT_OPEN ? "Can't open file: %s\n" :
+                 "Invalid menu file: %s\n", argv[ 2 + bad ] );
+        exit( EXIT_FAILURE );
+    }
+
+    int itemCount = menu->count;
+
+    // commands: each one timed on its own, with output thrown away
+    FILE *out = fopen( "/dev/null", "w" );
+    struct MenuSource *source = makeMenuSource( menu );
+    struct Session *session = makeSession( source, NULL, NULL, out );
+
+    struct Latencies latencies[ KIND_COUNT ];
+    for ( int k = 0; k < KIND_COUNT; k++ ) {
+        latencies[ k ].nanos = (long long *) malloc( LATENCY_INITIAL_CAPACITY *
+                               sizeof( long long ) );
+        latencies[ k ].count = 0;
+        latencies[ k ].capacity = LATENCY_INITIAL_CAPACITY;
+    }
+
+    long long commandNanos = 0;
+    for ( int i = 0; i < lineCount && !session->quit; i++ ) {
+
+        struct Latencies *list = &latencies[ classify( lines[ i ] ) ];
+
+        start = now();
+        runCommand( session, lines[ i ], lengths[ i ] );
+        fflush( out );
+        long long nanos = now() - start;
+
+        commandNanos += nanos;
+        if ( list->count >= list->capacity ) {
+            list->capacity *= 2;
+            list->nanos = (long long *) realloc( list->nanos,
+                                                 list->capacity * sizeof( long long ) );
+        }
+        list->nanos[ list->count++ ] = nanos;
+    }
+
+    freeSession( session );
+    freeMenuSource( source );
+    fclose( out );
+
+    printf( "{\n" );
+    printf( "  \"items\": %d,\n", itemCount );
+    printf( "  \"commands\": %d,\n", lineCount );
+    printf( "  \"traceBytes\": %lld,\n", bytes );
+    printf( "  \"phases\": {\n" );
+    printPhase( "read lines", readNanos, lineCount, "lines", false );
+    printPhase( "load", loadNanos, itemCount, "items", false );
+    printPhase( "commands", commandNanos, lineCount, "commands", true );
+    printf( "  },\n" );
+    printf( "  \"latency\": {\n" );
+
+    bool first = true;
+    for ( int k = 0; k < KIND_COUNT; k++ ) {
+
+        struct Latencies *list = &latencies[ k ];
+        if ( list->count == 0 ) {
+            free( list->nanos );
+            continue;
+        }
+
+        qsort( list->nanos, list->count, sizeof( long long ), compareNanos );
+
+        long long total = 0;
+        for ( int i = 0; i < list->count; i++ )
+            total += list->nanos[ i ];
+
+        printf( "%s    \"%s\": { \"count\": %d, \"seconds\": %.6f, \"perSecond\": %.1f, "
+                "\"p50us\": %.2f, \"p90us\": %.2f, \"p99us\": %.2f, \"maxus\": %.2f }",
+                first ? "" : ",\n", kindNames[ k ], list->count,
+                (double) total / NANOS_PER_SECOND,
+                total > 0 ? list->count / ( (double) total / NANOS_PER_SECOND ) : 0.0,
+                percentile( list, 50 ), percentile( list, 90 ), percentile( list, 99 ),
+                list->nanos[ list->count - 1 ] / NANOS_PER_MICRO );
+        first = false;
+
+        free( list->nanos );
+    }
+
+    printf( "\n  }\n" );
+    printf( "}\n" );
+
+    for ( int i = 0; i < lineCount; i++ )
+        free( lines[ i ] );
+    free( lines );
+    free( lengths );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/**
+    @filename check.c
+    @author Will Greene (wgreene)
+
+    Validates menu files in one streaming pass, reporting every bad line
+    instead of stopping at the first one.
+  */
+#include "menu.h"
+#include "input.h"
+#include "check.h"
+#include "stats.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** what's wrong with a line, by parseMenuLine() result */
+static char const *lineProblems[] = {
+    "",
+    "blank line",
+    "id must be exactly 4 characters",
+    "category must be at most 15 characters",
+    "cost must be a whole number of cents from 1 to 2147483647",
+    "name must be 1 to 20 characters",
+};
+
+/**
+    State of a check: where every id was first seen, and the problems so far.
+  */
+struct Checker {
+    unsigned int *keys;       // packed id in each slot of the id table
+    int *files;               // file the id was first seen in
+    int *lines;               // line the id was first seen on ( 0 if the slot is empty )
+    int size;                 // number of slots in the id table ( a power of 2 )
+    int count;                // number of ids in the table
+    char *const *filenames;   // files being checked
+    FILE *out;                // where problems are reported
+    long long problems;       // number of problems found
+};
+
+/**
+    Finds the slot of an id in the checker's table, or the empty slot where
+    it would go.
+
+    @param *checker Checker to search
+    @param key packed id
+    @return the slot
+  */
+static int findIdSlot( struct Checker const *checker, unsigned int key ) {
+
+    unsigned int mask = checker->size - 1;
+    unsigned int i = hashMenuItemKey( key ) & mask;
+
+    while ( checker->lines[ i ] && checker->keys[ i ] != key )
+        i = ( i + 1 ) & mask;
+
+    return i;
+}
+
+/**
+    Doubles the size of the checker's id table.
+
+    @param *checker Checker whose table should grow
+  */
+static void growIdTable( struct Checker *checker ) {
+
+    unsigned int *oldKeys = checker->keys;
+    int *oldFiles = checker->files;
+    int *oldLines = checker->lines;
+    int oldSize = checker->size;
+
+    checker->size *= 2;
+    checker->keys = ( unsigned int * ) statsMalloc( checker->size * sizeof( unsigned int ) );
+    checker->files = ( int * ) statsMalloc( checker->size * sizeof( int ) );
+    checker->lines = ( int * ) statsCalloc( checker->size, sizeof( int ) );
+
+    for ( int i = 0; i < oldSize; i++ ) {
+        if ( oldLines[ i ] ) {
+            int slot = findIdSlot( checker, oldKeys[ i ] );
+            checker->keys[ slot ] = oldKeys[ i ];
+            checker->files[ slot ] = oldFiles[ i ];
+            checker->lines[ slot ] = oldLines[ i ];
+        }
+    }
+
+    statsFree( oldKeys );
+    statsFree( oldFiles );
+    statsFree( oldLines );
+}
+
+/**
+    Checks one line, reporting anything wrong with it.
+
+    @param *checker Checker to record in
+    @param file index of the file the line is in
+    @param line line number ( from 1 )
+    @param *p first character of the line
+    @param *end one past the last character of the line
+  */
+static void checkLine( struct Checker *checker, int file, int line, char const *p,
+                       char const *end ) {
+
+    struct MenuItem item;
+    int result = parseMenuLine( p, end, &item );
+
+    if ( result != LINE_OK ) {
+        fprintf( checker->out, "%s:%d: %s\n", checker->filenames[ file ], line,
+                 lineProblems[ result ] );
+        checker->problems++;
+        return;
+    }
+
+    unsigned int key = menuItemKey( item.id );
+    int slot = findIdSlot( checker, key );
+
+    if ( checker->lines[ slot ] ) {
+        fprintf( checker->out, "%s:%d: id %s was already used on %s:%d\n",
+                 checker->filenames[ file ], line, item.id,
+                 checker->filenames[ checker->files[ slot ] ], checker->lines[ slot ] );
+        checker->problems++;
+        return;
+    }
+
+    checker->keys[ slot ] = key;
+    checker->files[ slot ] = file;
+    checker->lines[ slot ] = line;
+
+    // keep the table at most half full
+    if ( ++checker->count * 2 > checker->size )
+        growIdTable( checker );
+}
+
+/**
+    Checks every line of one file. Regular files are memory-mapped and split
+    into lines with memchr(); anything else is read with getLine().
+
+    @param *checker Checker to record in
+    @param file index of the file to check
+    @return false if the file can't be opened or read
+  */
+static bool checkFile( struct Checker *checker, int file ) {
+
+    int fd = open( checker->filenames[ file ], O_RDONLY );
+    if ( fd < 0 )
+        return false;
+
+    int line = 0;
+
+    struct stat st;
+    if ( fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 ) {
+
+        char *data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+        if ( data != MAP_FAILED ) {
+
+            posix_madvise( data, st.st_size, POSIX_MADV_SEQUENTIAL );
+
+            char const *p = data;
+            char const *end = data + st.st_size;
+            while ( p < end ) {
+                char const *nl = memchr( p, '\n', end - p );
+                char const *lineEnd = nl ? nl : end;
+                checkLine( checker, file, ++line, p, lineEnd );
+                p = nl ? nl + 1 : end;
+            }
+
+            munmap( data, st.st_size );
+            close( fd );
+            return true;
+        }
+    }
+
+    struct LineReader *reader = makeLineReader( fd );
+    char *str = NULL;
+    int strCapacity = 0;
+    int len;
+
+    while ( ( len = getLine( reader, &str, &strCapacity ) ) >= 0 )
+        checkLine( checker, file, ++line, str, str + len );
+
+    statsFree( str );
+    freeLineReader( reader );
+    close( fd );
+    return len != LINE_ERROR;
+}
+
+/**
+    Checks menu files against every rule the loader enforces, without
+    building a Menu, and reports every problem as file:line: message rather
+    than stopping at the first. Ids are checked for repeats across all of the
+    files, in the order given.
+
+    @param *filenames names of the files to check
+    @param count number of files
+    @param *out stream to report problems to
+    @return the number of problems found ( files that can't be read count as one )
+  */
+long long checkMenuFiles( char *const *filenames, int count, FILE *out ) {
+
+    struct Checker checker;
+    checker.size = CHECK_ID_TABLE_INITIAL_SIZE;
+    checker.count = 0;
+    checker.keys = ( unsigned int * ) statsMalloc( checker.size * sizeof( unsigned int ) );
+    checker.files = ( int * ) statsMalloc( checker.size * sizeof( int ) );
+    checker.lines = ( int * ) statsCalloc( checker.size, sizeof( int ) );
+    checker.filenames = filenames;
+    checker.out = out;
+    checker.problems = 0;
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( !checkFile( &checker, i ) ) {
+            fprintf( out, "%s: can't read file\n", filenames[ i ] );
+            checker.problems++;
+        }
+    }
+
+    statsFree( checker.keys );
+    statsFree( checker.files );
+    statsFree( checker.lines );
+
+    return checker.problems;
+}
@@ -0,0 +1,25 @@
+/**
+    @filename check.h
+    @author Will Greene (wgreene)
+
+    Header file for check.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/** initial number of slots in the table of ids seen ( a power of 2 ) */
+#define CHECK_ID_TABLE_INITIAL_SIZE 1024
+
+/**
+    Checks menu files against every rule the loader enforces, without
+    building a Menu, and reports every problem as file:line: message rather
+    than stopping at the first. Ids are checked for repeats across all of the
+    files, in the order given.
+
+    @param *filenames names of the files to check
+    @param count number of files
+    @param *out stream to report problems to
+    @return the number of problems found ( files that can't be read count as one )
+  */
+long long checkMenuFiles( char *const *filenames, int count, FILE *out );
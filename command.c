@@ -0,0 +1,887 @@
+/**
+    @filename command.c
+    @author Will Greene (wgreene)
+
+    Splits kiosk commands into words and dispatches them to the code that
+    carries them out.
+  */
+#include "input.h"
+#include "menu.h"
+#include "order.h"
+#include "reload.h"
+#include "stats.h"
+#include "search.h"
+#include "pool.h"
+#include "journal.h"
+#include "ticket.h"
+#include "command.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+
+/**
+    A handler for one kind of command.
+  */
+struct CommandHandler {
+    char const *name; // word that selects the command
+    int words;        // number of words the command takes ( 0 if the handler checks )
+    bool (*run)( struct Session *session, struct Command const *command ); // false if invalid
+    enum StatsCounter stat; // counter for the command ( see stats.h )
+};
+
+/**
+    Prints a command back, followed by a blank line ( the response to a
+    command that worked but has nothing else to say ).
+
+    @param *session Session the command ran in
+    @param *command Command to print
+  */
+static void echoCommand( struct Session *session, struct Command const *command ) {
+
+    fwrite( command->line, 1, command->length, session->out );
+    fputs( "\n\n", session->out );
+}
+
+/**
+    Parses a quantity: a whole number from 1 to INT_MAX, with nothing else in
+    the word.
+
+    @param *word word to parse
+    @param *quantity where to store the quantity
+    @return true if the word is a valid quantity
+  */
+static bool parseQuantity( char const *word, int *quantity ) {
+
+    if ( !*word )
+        return false;
+
+    long value = 0;
+    for ( ; *word; word++ ) {
+        if ( !isdigit( (unsigned char) *word ) )
+            return false;
+        value = value * 10 + ( *word - '0' );
+        if ( value > INT_MAX )
+            return false;
+    }
+
+    if ( value < 1 )
+        return false;
+
+    *quantity = value;
+    return true;
+}
+
+/**
+    Parses an amount of money in dollars: whole dollars, optionally followed
+    by a point and one or two digits of cents.
+
+    @param *word word to parse
+    @param *cents where to store the amount, in cents
+    @return true if the word is a valid amount
+  */
+static bool parseDollars( char const *word, long long *cents ) {
+
+    long long dollars = 0;
+    int digits = 0;
+    for ( ; isdigit( (unsigned char) *word ); word++, digits++ ) {
+        dollars = dollars * 10 + ( *word - '0' );
+        if ( dollars > INT_MAX / CENTS_PER_DOLLAR )
+            return false;
+    }
+
+    long long fraction = 0;
+    int fractionDigits = 0;
+    if ( *word == '.' ) {
+        for ( word++; isdigit( (unsigned char) *word ) && fractionDigits < 2; word++ ) {
+            fraction = fraction * 10 + ( *word - '0' );
+            fractionDigits++;
+        }
+        if ( fractionDigits == 0 )
+            return false;
+    }
+
+    if ( *word || digits + fractionDigits == 0 )
+        return false;
+
+    *cents = dollars * CENTS_PER_DOLLAR + ( fractionDigits == 1 ? fraction * 10 : fraction );
+    return true;
+}
+
+/**
+    Runs the "page <n> [size]" part of a list command, starting at the given
+    word.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @param word index of the "page" word
+    @param *category category to list, or NULL for the whole menu
+    @return true if the command is valid
+  */
+static bool listPage( struct Session *session, struct Command const *command, int word,
+                      char const *category ) {
+
+    int page;
+    int size = MENU_PAGE_SIZE;
+
+    if ( strcmp( command->words[ word ], "page" ) != 0 ||
+         !parseQuantity( command->words[ word + 1 ], &page ) ||
+         ( command->wordCount > word + 2 && !parseQuantity( command->words[ word + 2 ], &size ) ) )
+        return false;
+
+    fwrite( command->line, 1, command->length, session->out );
+    putc( '\n', session->out );
+    listMenuPage( session->menu, category, page, size, session->out );
+    return true;
+}
+
+/**
+    Runs "list menu" or "list menu page <n> [size]".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool listMenu( struct Session *session, struct Command const *command ) {
+
+    if ( command->wordCount == 4 || command->wordCount == 5 )
+        return listPage( session, command, 2, NULL );
+
+    if ( command->wordCount != 2 )
+        return false;
+
+    listMenuItems( session->menu, NULL, session->out );
+    return true;
+}
+
+/**
+    Runs "list category <category>" or "list category <category> page <n>".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool listCategory( struct Session *session, struct Command const *command ) {
+
+    if ( command->wordCount == 5 )
+        return listPage( session, command, 3, command->words[ 2 ] );
+
+    if ( command->wordCount != 3 )
+        return false;
+
+    listMenuItems( session->menu, command->words[ 2 ], session->out );
+    return true;
+}
+
+/**
+    Runs "list order".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool listOrder( struct Session *session, struct Command const *command ) {
+
+    fwrite( command->line, 1, command->length, session->out );
+    putc( '\n', session->out );
+    listOrderItems( session->order, session->out );
+    return true;
+}
+
+/**
+    Runs "list price <min> <max>" ( amounts in dollars ).
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool listPrice( struct Session *session, struct Command const *command ) {
+
+    long long min, max;
+
+    if ( !parseDollars( command->words[ 2 ], &min ) || !parseDollars( command->words[ 3 ], &max ) ||
+         min > max )
+        return false;
+
+    fwrite( command->line, 1, command->length, session->out );
+    putc( '\n', session->out );
+    listPriceRange( session->menu, min, max, session->out );
+    return true;
+}
+
+/**
+    Runs "list cheapest <n> [category]".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool listCheapestCommand( struct Session *session, struct Command const *command ) {
+
+    int count;
+
+    if ( command->wordCount < 3 || command->wordCount > 4 ||
+         !parseQuantity( command->words[ 2 ], &count ) )
+        return false;
+
+    fwrite( command->line, 1, command->length, session->out );
+    putc( '\n', session->out );
+    listCheapest( session->menu, count, command->wordCount == 4 ? command->words[ 3 ] : NULL,
+                  session->out );
+    return true;
+}
+
+/** commands selected by the second word of a list command */
+static struct CommandHandler const listHandlers[] = {
+    { "menu", 0, listMenu, STATS_LIST_MENU },
+    { "category", 0, listCategory, STATS_LIST_CATEGORY },
+    { "order", 2, listOrder, STATS_LIST_ORDER },
+    { "price", 4, listPrice, STATS_LIST_PRICE },
+    { "cheapest", 0, listCheapestCommand, STATS_LIST_CHEAPEST },
+};
+
+/**
+    Finds the handler for a word in a table.
+
+    @param *table handlers to choose from
+    @param count number of handlers in the table
+    @param *word word that selects the handler
+    @return the handler, or NULL if no handler has that name
+  */
+static struct CommandHandler const *findHandler( struct CommandHandler const *table, int count,
+                                                 char const *word ) {
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( strcmp( word, table[ i ].name ) == 0 )
+            return &table[ i ];
+    }
+
+    return NULL;
+}
+
+/**
+    Finds the handler for a word in a table and runs it.
+
+    @param *table handlers to choose from
+    @param count number of handlers in the table
+    @param *word word that selects the handler
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if a handler was found and the command is valid
+  */
+static bool dispatch( struct CommandHandler const *table, int count, char const *word,
+                      struct Session *session, struct Command const *command ) {
+
+    struct CommandHandler const *handler = findHandler( table, count, word );
+
+    if ( !handler || ( handler->words && handler->words != command->wordCount ) )
+        return false;
+
+    return handler->run( session, command );
+}
+
+/**
+    Runs "list ...", choosing what to list by the second word.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool list( struct Session *session, struct Command const *command ) {
+
+    if ( command->wordCount < 2 )
+        return false;
+
+    return dispatch( listHandlers, sizeof( listHandlers ) / sizeof( listHandlers[ 0 ] ),
+                     command->words[ 1 ], session, command );
+}
+
+/**
+    Runs "add <id> <quantity>".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool add( struct Session *session, struct Command const *command ) {
+
+    struct MenuItem *item = findMenuItem( session->menu, command->words[ 1 ] );
+    int quantity;
+
+    if ( !item || !parseQuantity( command->words[ 2 ], &quantity ) )
+        return false;
+
+    struct OrderItem *orderItem = findOrderItem( session->order, item->id );
+    if ( orderItem && orderItem->quantity > INT_MAX - quantity )
+        return false;
+
+    addOrderItem( session->order, item, quantity );
+    if ( session->journal )
+        journalRecord( session->journal, session->orders, JOURNAL_ADD, session->orders->current,
+                       item->id, quantity );
+    echoCommand( session, command );
+    return true;
+}
+
+/**
+    Runs "remove <id> <quantity>".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool removeCommand( struct Session *session, struct Command const *command ) {
+
+    // looked up in the order, since the item may have left the menu since it was added
+    struct OrderItem *orderItem = findOrderItem( session->order, command->words[ 1 ] );
+    int quantity;
+
+    if ( !orderItem || !parseQuantity( command->words[ 2 ], &quantity ) ||
+         quantity > orderItem->quantity )
+        return false;
+
+    // the MenuItem outlives the OrderItem, which goes once its quantity reaches zero
+    struct MenuItem const *item = orderItem->menuItem;
+
+    removeOrderItem( session->order, orderItem, quantity );
+    if ( session->journal )
+        journalRecord( session->journal, session->orders, JOURNAL_REMOVE, session->orders->current,
+                       item->id, quantity );
+    echoCommand( session, command );
+    return true;
+}
+
+/**
+    Opens a new, empty Order in the session and makes it the current one.
+
+    @param *session Session to open the Order in
+  */
+static void newOrder( struct Session *session ) {
+
+    int number = session->orders->next;
+
+    session->order = openOrder( session->orders, number );
+    if ( session->journal )
+        journalRecord( session->journal, session->orders, JOURNAL_OPEN, number, NULL, 0 );
+}
+
+/**
+    Prints a command line followed by the number of the current Order.
+
+    @param *session Session the command ran in
+    @param *command Command that ran
+  */
+static void echoOrderNumber( struct Session *session, struct Command const *command ) {
+
+    fwrite( command->line, 1, command->length, session->out );
+    fprintf( session->out, "\nOrder %d\n\n", session->orders->current );
+}
+
+/**
+    Runs "order new": opens a new, empty Order and switches to it.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool orderNew( struct Session *session, struct Command const *command ) {
+
+    newOrder( session );
+    echoOrderNumber( session, command );
+    return true;
+}
+
+/**
+    Runs "order switch <n>": makes another open Order the current one.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool orderSwitch( struct Session *session, struct Command const *command ) {
+
+    int number;
+    struct Order *order;
+
+    // an Order waiting for its ticket to be written is already checked out
+    if ( !parseQuantity( command->words[ 2 ], &number ) ||
+         !( order = findOrder( session->orders, number ) ) || order->ticket )
+        return false;
+
+    session->order = order;
+    session->orders->current = number;
+    if ( session->journal )
+        journalRecord( session->journal, session->orders, JOURNAL_SWITCH, number, NULL, 0 );
+
+    echoOrderNumber( session, command );
+    return true;
+}
+
+/**
+    Runs "order close": closes the current Order and starts a new, empty
+    one.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool orderClose( struct Session *session, struct Command const *command ) {
+
+    int number = session->orders->current;
+
+    closeOrder( session->orders, number );
+    if ( session->journal )
+        journalRecord( session->journal, session->orders, JOURNAL_CLOSE, number, NULL, 0 );
+
+    newOrder( session );
+    echoOrderNumber( session, command );
+    return true;
+}
+
+/**
+    Runs "checkout": freezes the current Order into a ticket for the
+    kitchen, then closes it and starts a new, empty one. If the kitchen's
+    queue is full the Order is kept, so it can be checked out again.
+
+    With a journal, the Order is only closed once the kitchen has written
+    its ticket ( see closeCheckedOut() ), so a crash before then brings the
+    Order back instead of losing it.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool checkout( struct Session *session, struct Command const *command ) {
+
+    int number = session->orders->current;
+
+    if ( !session->tickets || session->order->count == 0 )
+        return false;
+
+    struct Ticket *ticket = makeTicket( session->order, number );
+    long long ticketNumber = pushTicket( session->tickets, ticket );
+
+    if ( !ticketNumber ) {
+        statsFree( ticket );
+        fwrite( command->line, 1, command->length, session->out );
+        fputs( "\nThe kitchen is busy, try again\n\n", session->out );
+        return true;
+    }
+
+    if ( session->journal ) {
+        session->order->ticket = ticketNumber;
+        session->checkedOut++;
+        session->lastTicket = ticketNumber;
+    } else {
+        closeOrder( session->orders, number );
+    }
+    newOrder( session );
+
+    fwrite( command->line, 1, command->length, session->out );
+    fprintf( session->out, "\nTicket %lld\nOrder %d\n\n", ticketNumber, session->orders->current );
+    return true;
+}
+
+/** commands selected by the second word of an order command */
+static struct CommandHandler const orderHandlers[] = {
+    { "new", 2, orderNew, STATS_ORDER },
+    { "switch", 3, orderSwitch, STATS_ORDER },
+    { "close", 2, orderClose, STATS_ORDER },
+};
+
+/**
+    Runs "order ...", choosing what to do by the second word.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool order( struct Session *session, struct Command const *command ) {
+
+    if ( command->wordCount < 2 )
+        return false;
+
+    return dispatch( orderHandlers, sizeof( orderHandlers ) / sizeof( orderHandlers[ 0 ] ),
+                     command->words[ 1 ], session, command );
+}
+
+/**
+    Runs "find <text>". The text is the rest of the line, so it may contain
+    spaces.
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool find( struct Session *session, struct Command const *command ) {
+
+    if ( command->wordCount < 2 )
+        return false;
+
+    // skip to the second word, and drop trailing spaces
+    char const *p = command->line;
+    char const *end = p + command->length;
+    while ( isspace( (unsigned char) *p ) )
+        p++;
+    while ( !isspace( (unsigned char) *p ) )
+        p++;
+    while ( isspace( (unsigned char) *p ) )
+        p++;
+    while ( isspace( (unsigned char) end[ -1 ] ) )
+        end--;
+
+    char *text = ( char * ) arenaAlloc( session->scratch, end - p + 1 );
+    memcpy( text, p, end - p );
+    text[ end - p ] = '\0';
+
+    // echoed as typed; the trimmed copy is only for the search
+    fwrite( command->line, 1, command->length, session->out );
+    putc( '\n', session->out );
+    findMenuItems( session->menu, text, session->scratch, session->out );
+    return true;
+}
+
+/**
+    Runs "stats".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool stats( struct Session *session, struct Command const *command ) {
+
+    ( void ) command;
+    fputs( "stats\n", session->out );
+    printStats( session->out );
+    if ( statsEnabled && session->tickets )
+        printTicketStats( session->tickets, session->out );
+    return true;
+}
+
+/**
+    Runs "quit".
+
+    @param *session Session to run the command in
+    @param *command Command to run
+    @return true if the command is valid
+  */
+static bool quit( struct Session *session, struct Command const *command ) {
+
+    ( void ) command;
+    session->quit = true;
+    if ( session->journal )
+        resetJournal( session->journal );
+    fputs( "quit\n", session->out );
+    return true;
+}
+
+/** commands selected by the first word of a command */
+static struct CommandHandler const handlers[] = {
+    { "list", 0, list, STATS_INVALID },
+    { "add", 3, add, STATS_ADD },
+    { "remove", 3, removeCommand, STATS_REMOVE },
+    { "order", 0, order, STATS_ORDER },
+    { "checkout", 1, checkout, STATS_CHECKOUT },
+    { "find", 0, find, STATS_FIND },
+    { "stats", 1, stats, STATS_STATS },
+    { "quit", 1, quit, STATS_QUIT },
+};
+
+/**
+    Works out which statistics counter a command that has run belongs to.
+
+    @param *command Command that ran
+    @param valid true if the command was valid
+    @return the counter
+  */
+static enum StatsCounter commandCounter( struct Command const *command, bool valid ) {
+
+    if ( !valid )
+        return STATS_INVALID;
+
+    struct CommandHandler const *handler =
+        findHandler( handlers, sizeof( handlers ) / sizeof( handlers[ 0 ] ), command->words[ 0 ] );
+
+    // list commands are counted by what they list
+    if ( handler->run == list )
+        handler = findHandler( listHandlers, sizeof( listHandlers ) / sizeof( listHandlers[ 0 ] ),
+                               command->words[ 1 ] );
+
+    return handler->stat;
+}
+
+/**
+    Splits a command line into words in one pass. Words are copied, null
+    terminated, into the session's scratch arena.
+
+    @param *session Session whose scratch arena should be used
+    @param *command Command to fill in
+  */
+static void tokenize( struct Session *session, struct Command *command ) {
+
+    // the words and their terminators never take more room than the line itself
+    char const *p = command->line;
+    char const *end = p + command->length;
+    char *out = ( char * ) arenaAlloc( session->scratch, command->length + 1 );
+
+    command->wordCount = 0;
+
+    while ( true ) {
+
+        while ( p < end && isspace( (unsigned char) *p ) )
+            p++;
+        if ( p == end )
+            break;
+
+        if ( command->wordCount < MAX_COMMAND_WORDS )
+            command->words[ command->wordCount ] = out;
+        command->wordCount++;
+
+        while ( p < end && !isspace( (unsigned char) *p ) )
+            *out++ = *p++;
+        *out++ = '\0';
+    }
+}
+
+/**
+    Checks whether any of an Order's items come from the given Menu.
+
+    @param *order Order to check
+    @param *menu Menu to look for
+    @return true if an OrderItem points into the Menu
+  */
+static bool orderUsesMenu( struct Order const *order, struct Menu const *menu ) {
+
+    for ( int i = 0; i < order->count; i++ ) {
+        struct MenuItem const *item = order->list[ i ]->menuItem;
+        if ( item >= menu->items && item < menu->items + menu->count )
+            return true;
+    }
+
+    return false;
+}
+
+/**
+    Switches the session to the source's current Menu if it has been
+    replaced. Order items still on the menu, in every open Order, are moved
+    to the new Menu ( and repriced ); items that were taken off keep pointing
+    into the Menu they came from, which the session holds on to until they're
+    gone.
+
+    @param *session Session to update
+  */
+static void refreshMenu( struct Session *session ) {
+
+    if ( menuGeneration( session->source ) == session->generation )
+        return;
+
+    session->retired = ( struct Menu ** ) statsRealloc( session->retired,
+                       ( session->retiredCount + 1 ) * sizeof( struct Menu * ) );
+    session->retired[ session->retiredCount++ ] = session->menu;
+    session->menu = acquireMenu( session->source, &session->generation );
+
+    struct OrderBook *book = session->orders;
+    for ( int n = 0; n < book->open; n++ ) {
+
+        struct Order *order = book->orders[ n ];
+        for ( int i = 0; i < order->count; i++ ) {
+            struct MenuItem *item = findMenuItem( session->menu, order->list[ i ]->menuItem->id );
+            if ( item )
+                order->list[ i ]->menuItem = item;
+        }
+        repriceOrder( order );
+    }
+
+    int kept = 0;
+    for ( int i = 0; i < session->retiredCount; i++ ) {
+
+        bool used = false;
+        for ( int n = 0; n < book->open && !used; n++ )
+            used = orderUsesMenu( book->orders[ n ], session->retired[ i ] );
+
+        if ( used )
+            session->retired[ kept++ ] = session->retired[ i ];
+        else
+            releaseMenu( session->source, session->retired[ i ] );
+    }
+    session->retiredCount = kept;
+}
+
+/**
+    Allocates storage for a Session. With a journal, the session's Orders
+    are rebuilt from it; otherwise ( or if none were left open ) the session
+    starts with one new, empty Order.
+
+    @param *source MenuSource to order from
+    @param *journal Journal to record the Orders in ( NULL for none )
+    @param *tickets TicketQueue to check Orders out to ( NULL for none )
+    @param *out stream to print command output to
+    @return the Session
+  */
+struct Session *makeSession( struct MenuSource *source, struct Journal *journal,
+                             struct TicketQueue *tickets, FILE *out ) {
+
+    struct Session *session = (struct Session *) statsMalloc( sizeof( struct Session ) );
+
+    session->source = source;
+    session->menu = acquireMenu( source, &session->generation );
+    session->retired = NULL;
+    session->retiredCount = 0;
+    session->orders = makeOrderBook();
+    session->out = out;
+    session->quit = false;
+    session->scratch = makeArena();
+    session->journal = journal;
+    session->tickets = tickets;
+    session->checkedOut = 0;
+    session->lastTicket = 0;
+
+    if ( journal )
+        replayJournal( journal, session->orders, session->menu );
+
+    session->order = findOrder( session->orders, session->orders->current );
+    if ( !session->order )
+        newOrder( session );
+
+    return session;
+}
+
+/**
+    Frees the memory used to store the given Session and its Orders, and
+    lets go of its Menus.
+
+    @param *session Session to be freed
+  */
+void freeSession( struct Session *session ) {
+
+    freeArena( session->scratch );
+    freeOrderBook( session->orders );
+
+    for ( int i = 0; i < session->retiredCount; i++ )
+        releaseMenu( session->source, session->retired[ i ] );
+    statsFree( session->retired );
+    releaseMenu( session->source, session->menu );
+
+    statsFree( session );
+}
+
+/**
+    Splits a command line into words and runs it, first switching the
+    session to a newer Menu if the current one has been replaced.
+
+    @param *session Session to run the command in
+    @param *line command line ( without the newline )
+    @param length number of characters in the line
+  */
+void runCommand( struct Session *session, char const *line, int length ) {
+
+    struct Command command;
+    command.line = line;
+    command.length = length;
+
+    long long start = statsStart();
+
+    resetArena( session->scratch );
+    refreshMenu( session );
+    tokenize( session, &command );
+
+    bool valid = command.wordCount > 0 &&
+                 dispatch( handlers, sizeof( handlers ) / sizeof( handlers[ 0 ] ),
+                           command.words[ 0 ], session, &command );
+
+    if ( !valid ) {
+        fwrite( line, 1, length, session->out );
+        fputs( "\nInvalid command\n\n", session->out );
+    }
+
+    if ( statsEnabled )
+        statsStop( commandCounter( &command, valid ), start );
+}
+
+/**
+    Closes the checked-out Orders whose tickets the kitchen has written,
+    recording each close in the journal.
+
+    @param *session Session to update
+  */
+static void closeCheckedOut( struct Session *session ) {
+
+    if ( session->checkedOut == 0 )
+        return;
+
+    long long written = ticketsWritten( session->tickets );
+    struct OrderBook *book = session->orders;
+
+    // closing an Order moves the last one into its place
+    for ( int n = 0; n < book->open; ) {
+
+        struct Order *order = book->orders[ n ];
+        if ( !order->ticket || order->ticket > written ) {
+            n++;
+            continue;
+        }
+
+        int number = order->number;
+        closeOrder( book, number );
+        journalRecord( session->journal, book, JOURNAL_CLOSE, number, NULL, 0 );
+        session->checkedOut--;
+    }
+}
+
+/**
+    Runs kiosk commands read from the given reader against a new, empty Order
+    until the input runs out or a quit command is read. If the source's Menu
+    is replaced, the session switches to it before its next command, and the
+    Orders' items are moved over to the new Menu. With a journal, the Orders
+    start out as the journal left them, are synced to it whenever the session
+    waits for input, and a quit command empties the journal.
+
+    @param *source MenuSource to order from
+    @param *journal Journal to record the Orders in ( NULL for none )
+    @param *tickets TicketQueue to check Orders out to ( NULL for none )
+    @param *reader LineReader to read commands from
+    @param *out stream to print command output to
+    @param prompt true if a "cmd> " prompt should be printed before each command
+    @param interactive true if a person is typing the commands ( the prompt is flushed )
+  */
+void runSession( struct MenuSource *source, struct Journal *journal, struct TicketQueue *tickets,
+                 struct LineReader *reader, FILE *out, bool prompt, bool interactive ) {
+
+    struct Session *session = makeSession( source, journal, tickets, out );
+
+    // one line buffer is reused for every command
+    char *line = NULL;
+    int lineCapacity = 0;
+
+    while ( !session->quit ) {
+
+        if ( prompt ) {
+            fputs( "cmd> ", out );
+            if ( interactive )
+                fflush( out );
+        }
+
+        // close the Orders whose tickets are out, and sync the journal while
+        // waiting for the next command rather than while running one
+        closeCheckedOut( session );
+        if ( journal && !lineReady( reader ) )
+            syncJournal( journal );
+
+        int length = getLine( reader, &line, &lineCapacity );
+        if ( length == LINE_ERROR )
+            fprintf( stderr, "Can't read commands: %s\n", strerror( errno ) );
+        if ( length < 0 )
+            break;
+
+        runCommand( session, line, length );
+    }
+
+    // a quit has emptied the journal already
+    if ( session->checkedOut && !session->quit ) {
+        waitForTicket( tickets, session->lastTicket );
+        closeCheckedOut( session );
+    }
+
+    statsFree( line );
+    freeSession( session );
+}
@@ -0,0 +1,103 @@
+/**
+    @filename command.h
+    @author Will Greene (wgreene)
+
+    Header file for command.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+struct LineReader;
+struct Menu;
+struct MenuSource;
+struct Order;
+struct OrderBook;
+struct Arena;
+struct Journal;
+struct TicketQueue;
+
+/** maximum number of words in a command that are kept by the tokenizer */
+#define MAX_COMMAND_WORDS 5
+
+/**
+    A command line split into words.
+  */
+struct Command {
+    char const *line;                // the whole command line, as typed
+    int length;                      // number of characters in the line
+    char *words[ MAX_COMMAND_WORDS ]; // the first words of the line ( null terminated )
+    int wordCount;                   // number of words in the line ( may be more than are kept )
+};
+
+/**
+    A kiosk session: one person ( or script ) ordering from the menu.
+  */
+struct Session {
+    struct MenuSource *source; // where the current menu comes from
+    struct Menu *menu;         // menu to order from ( only read, so sessions can share it )
+    int generation;            // generation of the menu ( see reload.h )
+    struct Menu **retired;     // replaced menus that the order still has items from
+    int retiredCount;          // number of retired menus
+    struct OrderBook *orders;  // the session's open orders
+    struct Order *order;       // the current order ( the one in orders numbered orders->current )
+    FILE *out;                 // where command output goes
+    bool quit;                 // true once a quit command has been run
+    struct Arena *scratch;     // memory for the current command only ( words, search text )
+    struct Journal *journal;   // where changes to the orders are recorded ( NULL if they aren't )
+    struct TicketQueue *tickets; // where checked-out orders go ( NULL if they can't be )
+    int checkedOut;            // orders checked out but still in the journal ( see checkout() )
+    long long lastTicket;      // ticket of the latest of them
+};
+
+/**
+    Allocates storage for a Session. With a journal, the session's Orders
+    are rebuilt from it; otherwise ( or if none were left open ) the session
+    starts with one new, empty Order.
+
+    @param *source MenuSource to order from
+    @param *journal Journal to record the Orders in ( NULL for none )
+    @param *tickets TicketQueue to check Orders out to ( NULL for none )
+    @param *out stream to print command output to
+    @return the Session
+  */
+struct Session *makeSession( struct MenuSource *source, struct Journal *journal,
+                             struct TicketQueue *tickets, FILE *out );
+
+/**
+    Frees the memory used to store the given Session and its Orders, and
+    lets go of its Menus.
+
+    @param *session Session to be freed
+  */
+void freeSession( struct Session *session );
+
+/**
+    Runs kiosk commands read from the given reader against a new, empty Order
+    until the input runs out or a quit command is read. If the source's Menu
+    is replaced, the session switches to it before its next command, and the
+    Orders' items are moved over to the new Menu. With a journal, the Orders
+    start out as the journal left them, are synced to it whenever the session
+    waits for input, and a quit command empties the journal.
+
+    @param *source MenuSource to order from
+    @param *journal Journal to record the Orders in ( NULL for none )
+    @param *tickets TicketQueue to check Orders out to ( NULL for none )
+    @param *reader LineReader to read commands from
+    @param *out stream to print command output to
+    @param prompt true if a "cmd> " prompt should be printed before each command
+    @param interactive true if a person is typing the commands ( the prompt is flushed )
+  */
+void runSession( struct MenuSource *source, struct Journal *journal, struct TicketQueue *tickets,
+                 struct LineReader *reader, FILE *out, bool prompt, bool interactive );
+
+/**
+    Splits a command line into words and runs it, first switching the
+    session to a newer Menu if the current one has been replaced.
+
+    @param *session Session to run the command in
+    @param *line command line ( without the newline )
+    @param length number of characters in the line
+  */
+void runCommand( struct Session *session, char const *line, int length );
@@ -0,0 +1,113 @@
+/**
+    @filename genmenu.c
+    @author Will Greene (wgreene)
+
+    Writes a synthetic menu file in the style of menu-d.txt, with any number
+    of valid items, for benchmarking.
+
+    usage: genmenu <item-count> [seed]
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+/** number of distinct ids made of digits only */
+#define DIGIT_IDS 10000
+
+/** characters used for ids once there are more items than digit ids */
+#define ID_CHARS "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+
+/** number of distinct ids made of ID_CHARS ( 62 ^ 4 ) */
+#define MAX_IDS 14776336
+
+/** cheapest and most expensive item, in cents */
+#define MIN_COST 100
+#define MAX_COST 3000
+
+/** categories used by menu-d.txt */
+static char const *categories[] = {
+    "Appetizer", "Beverage", "Dessert", "Entree", "Pasta",
+    "Pizza", "Salad", "Sandwich", "Seafood", "Soup",
+};
+
+/** state of the random number generator */
+static unsigned long long randomState;
+
+/**
+    Returns the next pseudo-random number ( xorshift64 ), so the same seed
+    always gives the same menu.
+
+    @return a random number
+  */
+static unsigned long long nextRandom() {
+
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+/**
+    Writes the id for the given position in a permutation of all ids, so ids
+    are unique but not in order.
+
+    @param n position of the item
+    @param idCount number of possible ids
+    @param *id where to write the id ( 5 characters )
+  */
+static void makeId( long long n, long long idCount, char *id ) {
+
+    // 7919 shares no factor with 10000 or 62 ^ 4, so this visits every id once
+    long long value = n * 7919 % idCount;
+    int base = idCount == DIGIT_IDS ? 10 : (int) strlen( ID_CHARS );
+
+    for ( int i = 3; i >= 0; i-- ) {
+        id[ i ] = ID_CHARS[ value % base ];
+        value /= base;
+    }
+    id[ 4 ] = '\0';
+}
+
+/**
+    Starting point. Writes the menu to standard output.
+
+    @param argc number of arguments
+    @param *argv[] array of pointers to command line arguments
+    @return exit status
+  */
+int main( int argc, char *argv[] ) {
+
+    long long count = argc > 1 ? atoll( argv[ 1 ] ) : 0;
+    if ( argc < 2 || argc > 3 || count < 1 || count > MAX_IDS ) {
+        fprintf( stderr, "usage: genmenu <item-count> [seed]\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    randomState = argc > 2 ? strtoull( argv[ 2 ], NULL, 10 ) : 1;
+    if ( randomState == 0 )
+        randomState = 1;
+
+    long long idCount = count <= DIGIT_IDS ? DIGIT_IDS : MAX_IDS;
+    int categoryCount = sizeof( categories ) / sizeof( categories[ 0 ] );
+
+    char id[ 5 ];
+    char name[ 21 ];
+
+    for ( long long n = 0; n < count; n++ ) {
+
+        makeId( n, idCount, id );
+
+        int length = 1 + nextRandom() % 20;
+        for ( int i = 0; i < length; i++ ) {
+            int letter = nextRandom() % 52;
+            name[ i ] = letter < 26 ? 'A' + letter : 'a' + letter - 26;
+        }
+        name[ length ] = '\0';
+
+        printf( "%s %s %d %s\n", id, categories[ nextRandom() % categoryCount ],
+                (int) ( MIN_COST + nextRandom() % ( MAX_COST - MIN_COST + 1 ) ), name );
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/**
+    @filename gentrace.c
+    @author Will Greene (wgreene)
+
+    Writes a synthetic command trace for a menu file: a realistic mix of
+    list, add and remove commands, where every remove takes out something
+    that is really in the order.
+
+    usage: gentrace <menu-file> <command-count> [seed]
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+/** share of commands of each kind, in tenths of a percent ( the rest are list order ) */
+#define LIST_MENU_SHARE 1
+#define LIST_CATEGORY_SHARE 20
+#define ADD_SHARE 450
+#define REMOVE_SHARE 350
+
+/** largest quantity added at once */
+#define MAX_QUANTITY 50
+
+/** initial capacity of the arrays */
+#define INITIAL_CAPACITY 1024
+
+/** state of the random number generator */
+static unsigned long long randomState;
+
+/**
+    Returns the next pseudo-random number ( xorshift64 ), so the same seed
+    always gives the same trace.
+
+    @return a random number
+  */
+static unsigned long long nextRandom() {
+
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+/**
+    Something in the simulated order.
+  */
+struct Line {
+    int item;     // index of the menu item
+    int quantity; // how many are in the order
+};
+
+/**
+    Starting point. Reads the menu and writes the trace to standard output.
+
+    @param argc number of arguments
+    @param *argv[] array of pointers to command line arguments
+    @return exit status
+  */
+int main( int argc, char *argv[] ) {
+
+    long count = argc > 2 ? atol( argv[ 2 ] ) : 0;
+    FILE *fp = argc > 1 ? fopen( argv[ 1 ], "r" ) : NULL;
+
+    if ( argc < 3 || argc > 4 || count < 1 || !fp ) {
+        fprintf( stderr, "usage: gentrace <menu-file> <command-count> [seed]\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    randomState = argc > 3 ? strtoull( argv[ 3 ], NULL, 10 ) : 1;
+    if ( randomState == 0 )
+        randomState = 1;
+
+    // ids and distinct categories of the menu
+    char ( *ids )[ 5 ] = malloc( INITIAL_CAPACITY * sizeof( *ids ) );
+    int idCount = 0;
+    int idCapacity = INITIAL_CAPACITY;
+    char ( *categories )[ 16 ] = malloc( INITIAL_CAPACITY * sizeof( *categories ) );
+    int categoryCount = 0;
+
+    char id[ 5 ];
+    char category[ 16 ];
+    while ( fscanf( fp, "%4s %15s %*[^\n]", id, category ) == 2 ) {
+
+        if ( idCount >= idCapacity ) {
+            idCapacity *= 2;
+            ids = realloc( ids, idCapacity * sizeof( *ids ) );
+        }
+        strcpy( ids[ idCount++ ], id );
+
+        bool seen = false;
+        for ( int i = 0; i < categoryCount && !seen; i++ )
+            seen = strcmp( categories[ i ], category ) == 0;
+        if ( !seen && categoryCount < INITIAL_CAPACITY )
+            strcpy( categories[ categoryCount++ ], category );
+    }
+    fclose( fp );
+
+    if ( idCount == 0 ) {
+        fprintf( stderr, "No menu items in: %s\n", argv[ 1 ] );
+        exit( EXIT_FAILURE );
+    }
+
+    // the simulated order, and where each item is in it ( -1 if it isn't )
+    struct Line *order = malloc( idCount * sizeof( struct Line ) );
+    int orderCount = 0;
+    int *position = malloc( idCount * sizeof( int ) );
+    for ( int i = 0; i < idCount; i++ )
+        position[ i ] = -1;
+
+    for ( long n = 0; n < count; n++ ) {
+
+        int r = nextRandom() % 1000;
+
+        if ( r < LIST_MENU_SHARE )
+            printf( "list menu\n" );
+
+        else if ( ( r -= LIST_MENU_SHARE ) < LIST_CATEGORY_SHARE )
+            printf( "list category %s\n", categories[ nextRandom() % categoryCount ] );
+
+        else if ( ( r -= LIST_CATEGORY_SHARE ) < ADD_SHARE || orderCount == 0 ) {
+
+            int item = nextRandom() % idCount;
+            int quantity = 1 + nextRandom() % MAX_QUANTITY;
+            printf( "add %s %d\n", ids[ item ], quantity );
+
+            if ( position[ item ] < 0 ) {
+                position[ item ] = orderCount;
+                order[ orderCount ].item = item;
+                order[ orderCount++ ].quantity = 0;
+            }
+            order[ position[ item ] ].quantity += quantity;
+        }
+
+        else if ( ( r -= ADD_SHARE ) < REMOVE_SHARE ) {
+
+            int pos = nextRandom() % orderCount;
+            struct Line *line = &order[ pos ];
+            int quantity = 1 + nextRandom() % line->quantity;
+            printf( "remove %s %d\n", ids[ line->item ], quantity );
+
+            line->quantity -= quantity;
+            if ( line->quantity == 0 ) {
+                position[ line->item ] = -1;
+                order[ pos ] = order[ --orderCount ];
+                if ( pos < orderCount )
+                    position[ order[ pos ].item ] = pos;
+            }
+        }
+
+        else
+            printf( "list order\n" );
+    }
+
+    printf( "quit\n" );
+
+    free( ids );
+    free( categories );
+    free( order );
+    free( position );
+    return EXIT_SUCCESS;
+}
@@ -1,56 +1,135 @@
 /**
     @filename input.c
     @author Will Greene (wgreene)
-    
-    Reads a line of input.
+
+    Reads lines of input.
   */
 #include "input.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
 
 /**
-    Reads a line of input and returns it as a string pointer.
-    
-    @param *fp pointer to a file to read from
-    @return a string pointer
+    Allocates storage for a LineReader over the given file descriptor.
+
+    @param fd file descriptor to read from ( not closed by the reader )
+    @return the LineReader
   */
-char *readLine( FILE *fp ) {
-
-    // MEASURE LINE - START --------------------------------
-    
-    long startOfLine = ftell( fp );
-    
-    int ch = fgetc( fp );
-    if ( ch == EOF )
-        return NULL;
-    
-    int numChar = 0;
-    while ( ch != '\n' && ch != EOF ) {
-        numChar++;
-        ch = fgetc( fp );
-    }
-    
-    bool addNL = true;
-    if ( ch == '\n' )
-        numChar++;
-    if ( ch == EOF ) {
-        ungetc( ch, fp );
-        addNL = false;
-    }
-        
-    fseek( fp, startOfLine, SEEK_SET );
-
-    // MEASURE LINE - END ----------------------------------
-    
-    char *str = (char *) malloc(numChar * sizeof( char *));
-    
-    for ( int i = 0; i < numChar - 1; i++ ) {
-        int ch = fgetc( fp );
-        str[ i ] = ch;
+struct LineReader *makeLineReader( int fd ) {
+
+    struct LineReader *reader = (struct LineReader *) statsMalloc( sizeof( struct LineReader ) );
+
+    reader->fd = fd;
+    reader->block = (char *) statsMalloc( INPUT_BLOCK_SIZE );
+    reader->pos = 0;
+    reader->len = 0;
+
+    return reader;
+}
+
+/**
+    Frees the memory used to store the given LineReader.
+
+    @param *reader LineReader to be freed
+  */
+void freeLineReader( struct LineReader *reader ) {
+
+    statsFree( reader->block );
+    statsFree( reader );
+}
+
+/**
+    Makes sure the caller's line buffer can hold the given number of characters.
+
+    @param **line pointer to the caller's line buffer
+    @param *capacity pointer to the capacity of the caller's line buffer
+    @param needed number of characters needed
+  */
+static void growLine( char **line, int *capacity, int needed ) {
+
+    if ( needed <= *capacity )
+        return;
+
+    int newCapacity = *capacity > 0 ? *capacity : LINE_INITIAL_CAPACITY;
+    while ( newCapacity < needed )
+        newCapacity *= 2;
+
+    *line = (char *) statsRealloc( *line, newCapacity );
+    *capacity = newCapacity;
+}
+
+/**
+    Checks whether the next line can be read without waiting for more input.
+
+    @param *reader LineReader to check
+    @return true if a whole line is already in the block
+  */
+bool lineReady( struct LineReader const *reader ) {
+
+    return reader->pos < reader->len &&
+           memchr( reader->block + reader->pos, '\n', reader->len - reader->pos ) != NULL;
+}
+
+/**
+    Reads the next line into a caller-owned buffer, growing it as needed. The
+    newline is not stored, and the line is always null terminated. The buffer
+    may be NULL with a capacity of 0 on the first call.
+
+    @param *reader LineReader to read from
+    @param **line pointer to the caller's line buffer
+    @param *capacity pointer to the capacity of the caller's line buffer
+    @return the length of the line, LINE_END if there are no more lines, or
+            LINE_ERROR if reading failed ( errno says why )
+  */
+int getLine( struct LineReader *reader, char **line, int *capacity ) {
+
+    int length = 0;
+    bool any = false;
+
+    while ( true ) {
+
+        // refill the block once everything in it has been handed out
+        if ( reader->pos >= reader->len ) {
+            int n = read( reader->fd, reader->block, INPUT_BLOCK_SIZE );
+
+            // a signal interrupting the read isn't the end of the input
+            if ( n < 0 && errno == EINTR )
+                continue;
+            if ( n < 0 )
+                return LINE_ERROR;
+            if ( n == 0 )
+                break;
+            reader->pos = 0;
+            reader->len = n;
+        }
+
+        any = true;
+
+        char *start = reader->block + reader->pos;
+        int avail = reader->len - reader->pos;
+        char *nl = (char *) memchr( start, '\n', avail );
+        int take = nl ? nl - start : avail;
+
+        growLine( line, capacity, length + take + 1 );
+        memcpy( *line + length, start, take );
+        length += take;
+
+        if ( nl ) {
+            reader->pos += take + 1;
+            ( *line )[ length ] = '\0';
+            return length;
+        }
+
+        reader->pos = reader->len;
     }
-    
-    str[ numChar - 1 ] = '\0';
-    
-    if ( addNL )
-        fgetc( fp );
-    
-    return str;
+
+    if ( !any )
+        return LINE_END;
+
+    // last line of the file had no newline
+    growLine( line, capacity, length + 1 );
+    ( *line )[ length ] = '\0';
+    return length;
 }
@@ -1,17 +1,67 @@
 /**
     @filename input.h
     @author Will Greene (wgreene)
-    
+
     Header file for input.c
   */
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
+/** number of bytes requested from the file by each block read */
+#define INPUT_BLOCK_SIZE 65536
+
+/** initial number of characters in a line buffer grown by getLine() */
+#define LINE_INITIAL_CAPACITY 128
+
+/** getLine() result once the input runs out */
+#define LINE_END -1
+
+/** getLine() result when reading fails */
+#define LINE_ERROR -2
+
 /**
-    Reads a line of input and returns it as a string pointer.
-    
-    @param *fp pointer to a file to read from
-    @return a string pointer
+    A buffered reader that hands out one line at a time from large block reads.
+  */
+struct LineReader {
+    int fd;      // file descriptor to read from
+    char *block; // bytes from the most recent block read
+    int pos;     // index of the next unread byte in the block
+    int len;     // number of valid bytes in the block
+};
+
+/**
+    Allocates storage for a LineReader over the given file descriptor.
+
+    @param fd file descriptor to read from ( not closed by the reader )
+    @return the LineReader
+  */
+struct LineReader *makeLineReader( int fd );
+
+/**
+    Frees the memory used to store the given LineReader.
+
+    @param *reader LineReader to be freed
+  */
+void freeLineReader( struct LineReader *reader );
+
+/**
+    Checks whether the next line can be read without waiting for more input.
+
+    @param *reader LineReader to check
+    @return true if a whole line is already in the block
+  */
+bool lineReady( struct LineReader const *reader );
+
+/**
+    Reads the next line into a caller-owned buffer, growing it as needed. The
+    newline is not stored, and the line is always null terminated. The buffer
+    may be NULL with a capacity of 0 on the first call.
+
+    @param *reader LineReader to read from
+    @param **line pointer to the caller's line buffer
+    @param *capacity pointer to the capacity of the caller's line buffer
+    @return the length of the line, LINE_END if there are no more lines, or
+            LINE_ERROR if reading failed ( errno says why )
   */
-char *readLine( FILE *fp );
+int getLine( struct LineReader *reader, char **line, int *capacity );
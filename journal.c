@@ -0,0 +1,471 @@
+/**
+    @filename journal.c
+    @author Will Greene (wgreene)
+
+    Keeps an append-only journal of changes to a session's Orders, replays
+    it after a crash, and compacts it.
+  */
+#include "menu.h"
+#include "order.h"
+#include "journal.h"
+#include "stats.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+    The start of every journal file.
+  */
+struct JournalHeader {
+    char magic[ 8 ]; // JOURNAL_MAGIC ( not null terminated )
+    int version;     // JOURNAL_VERSION
+    int recordSize;  // sizeof( struct JournalRecord ) when written
+};
+
+/**
+    One change to a session's Orders.
+  */
+struct JournalRecord {
+    int op;                     // what happened ( a JournalOp )
+    int order;                  // number of the Order it happened to
+    int quantity;               // how many were added or removed ( 0 for other ops )
+    char id[ NUM_CHAR_ID - 1 ]; // id of the MenuItem ( not null terminated; zero for other ops )
+};
+
+/**
+    Writes all of a buffer to a file, however many write() calls it takes.
+
+    @param fd file to write to
+    @param *data bytes to write
+    @param size number of bytes
+    @return true if everything was written
+  */
+static bool writeAll( int fd, void const *data, size_t size ) {
+
+    char const *p = ( char const * ) data;
+
+    while ( size > 0 ) {
+        ssize_t n = write( fd, p, size );
+        if ( n <= 0 )
+            return false;
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+/**
+    Fills in the header every journal file starts with.
+
+    @param *header header to fill in
+  */
+static void makeHeader( struct JournalHeader *header ) {
+
+    memset( header, 0, sizeof( *header ) );
+    memcpy( header->magic, JOURNAL_MAGIC, sizeof( header->magic ) );
+    header->version = JOURNAL_VERSION;
+    header->recordSize = sizeof( struct JournalRecord );
+}
+
+/**
+    Fills in a journal record.
+
+    @param *record record to fill in
+    @param op what happened
+    @param number number of the Order it happened to
+    @param *id id of the MenuItem added or removed ( NULL for the other ops )
+    @param quantity how many were added or removed ( 0 for the other ops )
+  */
+static void makeRecord( struct JournalRecord *record, enum JournalOp op, int number,
+                        char const *id, int quantity ) {
+
+    memset( record, 0, sizeof( *record ) );
+    record->op = op;
+    record->order = number;
+    record->quantity = quantity;
+    if ( id )
+        memcpy( record->id, id, NUM_CHAR_ID - 1 );
+}
+
+/**
+    Checks that a journal record can be replayed: a known op on an Order
+    number a session could have reached. A corrupt order number would
+    otherwise have openOrder() grow the OrderBook without bound.
+
+    @param *record record to check
+    @return true if the record can be replayed
+  */
+static bool validRecord( struct JournalRecord const *record ) {
+
+    return record->op >= JOURNAL_OPEN && record->op <= JOURNAL_REMOVE &&
+           record->order > 0 && record->order <= JOURNAL_MAX_ORDER;
+}
+
+/**
+    Checks every record in a journal file.
+
+    @param fd the journal file
+    @param records number of whole records in the file
+    @return true if every record can be replayed
+  */
+static bool validRecords( int fd, long long records ) {
+
+    if ( records == 0 )
+        return true;
+
+    size_t size = sizeof( struct JournalHeader ) + records * sizeof( struct JournalRecord );
+    char *data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( data == MAP_FAILED )
+        return false;
+
+    struct JournalRecord const *record =
+        ( struct JournalRecord const * ) ( data + sizeof( struct JournalHeader ) );
+    bool ok = true;
+    for ( long long i = 0; i < records && ok; i++ )
+        ok = validRecord( &record[ i ] );
+
+    munmap( data, size );
+    return ok;
+}
+
+
+/**
+    Syncs the directory holding a file, so a rename into it survives a crash.
+
+    @param *filename name of the file whose directory is synced
+  */
+static void syncDirectory( char const *filename ) {
+
+    char const *slash = strrchr( filename, '/' );
+    int length = slash ? ( slash == filename ? 1 : slash - filename ) : 1;
+
+    char *dirName = ( char * ) statsMalloc( length + 1 );
+    memcpy( dirName, slash ? filename : ".", length );
+    dirName[ length ] = '\0';
+
+    int fd = open( dirName, O_RDONLY );
+    if ( fd >= 0 ) {
+        fsync( fd );
+        close( fd );
+    }
+
+    statsFree( dirName );
+}
+
+/**
+    Opens a journal file, creating it if it doesn't exist. Every record is
+    checked, so replaying the journal can't run into one that makes no sense.
+
+    @param *filename name of the journal file
+    @param **journal set to the Journal ( free it with freeJournal() )
+    @return JOURNAL_OK, JOURNAL_CANT_OPEN, or JOURNAL_INVALID if the file
+            isn't a journal this program can read or holds a record it can't
+            replay
+  */
+int openJournal( char const *filename, struct Journal **journal ) {
+
+    int fd = open( filename, O_RDWR | O_CREAT | O_APPEND, 0644 );
+    if ( fd < 0 )
+        return JOURNAL_CANT_OPEN;
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+        close( fd );
+        return JOURNAL_CANT_OPEN;
+    }
+
+    struct JournalHeader expected;
+    makeHeader( &expected );
+
+    if ( st.st_size == 0 ) {
+
+        // a new journal
+        if ( !writeAll( fd, &expected, sizeof( expected ) ) ) {
+            close( fd );
+            return JOURNAL_CANT_OPEN;
+        }
+        st.st_size = sizeof( expected );
+
+    } else {
+
+        // a record cut short by a crash is left off the count, and ignored
+        struct JournalHeader header;
+        long long records = ( st.st_size - sizeof( header ) ) / sizeof( struct JournalRecord );
+        if ( pread( fd, &header, sizeof( header ), 0 ) != sizeof( header ) ||
+             memcmp( &header, &expected, sizeof( header ) ) != 0 ||
+             !validRecords( fd, records ) ) {
+            close( fd );
+            return JOURNAL_INVALID;
+        }
+    }
+
+    *journal = ( struct Journal * ) statsMalloc( sizeof( struct Journal ) );
+    ( *journal )->fd = fd;
+    ( *journal )->filename = ( char * ) statsMalloc( strlen( filename ) + 1 );
+    strcpy( ( *journal )->filename, filename );
+    ( *journal )->records = ( st.st_size - sizeof( struct JournalHeader ) ) /
+                            sizeof( struct JournalRecord );
+    ( *journal )->unsynced = 0;
+    ( *journal )->compactAt = JOURNAL_COMPACT_RECORDS;
+
+    return JOURNAL_OK;
+}
+
+/**
+    Syncs and closes a journal file, and frees the memory used to store the
+    Journal.
+
+    @param *journal Journal to be freed
+  */
+void freeJournal( struct Journal *journal ) {
+
+    syncJournal( journal );
+    close( journal->fd );
+    statsFree( journal->filename );
+    statsFree( journal );
+}
+
+/**
+    Syncs the journal file to disk, whether or not records are waiting.
+
+    @param *journal Journal to sync
+  */
+static void syncFile( struct Journal *journal ) {
+
+    long long start = statsStart();
+
+    fdatasync( journal->fd );
+    journal->unsynced = 0;
+
+    statsStop( STATS_JOURNAL_SYNC, start );
+}
+
+/**
+    Syncs the records written since the last sync to disk, if there are any.
+    Sessions call this when they run out of input, so the sync happens while
+    nobody is waiting on a reply and no record stays unsynced while the
+    session is idle.
+
+    @param *journal Journal to sync
+  */
+void syncJournal( struct Journal *journal ) {
+
+    if ( journal->unsynced > 0 )
+        syncFile( journal );
+}
+
+/**
+    Applies one journal record to a session's Orders.
+
+    @param *record change to apply ( checked by validRecord() )
+    @param *book OrderBook to change
+    @param *menu Menu to find added items on
+  */
+static void applyRecord( struct JournalRecord const *record, struct OrderBook *book,
+                         struct Menu *menu ) {
+
+    if ( !validRecord( record ) )
+        return;
+
+    // compaction writes the open Orders in no particular order
+    if ( record->op == JOURNAL_OPEN ) {
+        if ( !findOrder( book, record->order ) )
+            openOrder( book, record->order );
+        return;
+    }
+
+    struct Order *order = findOrder( book, record->order );
+    if ( !order )
+        return;
+
+    if ( record->op == JOURNAL_CLOSE ) {
+        closeOrder( book, record->order );
+        return;
+    }
+
+    if ( record->op == JOURNAL_SWITCH ) {
+        book->current = record->order;
+        return;
+    }
+
+    char id[ NUM_CHAR_ID ];
+    memcpy( id, record->id, NUM_CHAR_ID - 1 );
+    id[ NUM_CHAR_ID - 1 ] = '\0';
+
+    struct OrderItem *orderItem = findOrderItem( order, id );
+    int quantity = record->quantity;
+
+    if ( record->op == JOURNAL_ADD && quantity > 0 ) {
+        struct MenuItem *item = findMenuItem( menu, id );
+        if ( item && !( orderItem && orderItem->quantity > INT_MAX - quantity ) )
+            addOrderItem( order, item, quantity );
+    } else if ( record->op == JOURNAL_REMOVE && orderItem && quantity > 0 ) {
+        removeOrderItem( order, orderItem,
+                         quantity < orderItem->quantity ? quantity : orderItem->quantity );
+    }
+}
+
+/**
+    Rebuilds a session's Orders from the journal, then compacts the journal.
+    Items that are no longer on the menu are dropped, and a record cut short
+    by a crash is ignored.
+
+    @param *journal Journal to replay
+    @param *book OrderBook to open the Orders in ( normally empty )
+    @param *menu Menu to find the items on
+  */
+void replayJournal( struct Journal *journal, struct OrderBook *book, struct Menu *menu ) {
+
+    size_t size = sizeof( struct JournalHeader ) +
+                  journal->records * sizeof( struct JournalRecord );
+
+    if ( journal->records > 0 ) {
+
+        char *data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, journal->fd, 0 );
+
+        if ( data != MAP_FAILED ) {
+
+            posix_madvise( data, size, POSIX_MADV_SEQUENTIAL );
+
+            struct JournalRecord const *records =
+                ( struct JournalRecord const * ) ( data + sizeof( struct JournalHeader ) );
+            for ( long long i = 0; i < journal->records; i++ )
+                applyRecord( &records[ i ], book, menu );
+
+            munmap( data, size );
+        }
+    }
+
+    compactJournal( journal, book );
+}
+
+/**
+    Records a change that has just been made to a session's Orders. The
+    journal is compacted each time it doubles in size since it was last
+    compacted.
+
+    @param *journal Journal to write to
+    @param *book OrderBook that was changed
+    @param op what happened
+    @param number number of the Order it happened to
+    @param *id id of the MenuItem added or removed ( NULL for the other ops )
+    @param quantity how many were added or removed ( 0 for the other ops )
+  */
+void journalRecord( struct Journal *journal, struct OrderBook const *book, enum JournalOp op,
+                    int number, char const *id, int quantity ) {
+
+    struct JournalRecord record;
+    makeRecord( &record, op, number, id, quantity );
+
+    // written straight away, so the change survives the process dying
+    if ( !writeAll( journal->fd, &record, sizeof( record ) ) ) {
+        fprintf( stderr, "Can't write journal file: %s\n", journal->filename );
+        return;
+    }
+
+    journal->records++;
+
+    // ... but only synced once enough records have gone by, or the session
+    // runs out of input
+    if ( ++journal->unsynced >= JOURNAL_SYNC_RECORDS )
+        syncJournal( journal );
+
+    if ( journal->records >= journal->compactAt )
+        compactJournal( journal, book );
+}
+
+/**
+    Rewrites the journal as the open Orders and their items, followed by
+    which Order is current, under a temporary name that is then renamed into
+    place.
+
+    @param *journal Journal to compact
+    @param *book OrderBook the journal is for
+    @return true if the journal was rewritten
+  */
+bool compactJournal( struct Journal *journal, struct OrderBook const *book ) {
+
+    // try again once it's doubled, whether or not this works
+    journal->compactAt = journal->records * 2;
+
+    char *tmpName = (char *) statsMalloc( strlen( journal->filename ) + sizeof( ".tmp" ) );
+    strcpy( tmpName, journal->filename );
+    strcat( tmpName, ".tmp" );
+
+    int fd = open( tmpName, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644 );
+    if ( fd < 0 ) {
+        statsFree( tmpName );
+        return false;
+    }
+
+    long long count = book->current ? 1 : 0;
+    for ( int n = 0; n < book->open; n++ )
+        count += 1 + book->orders[ n ]->count;
+
+    // the header and every record go out in one write
+    size_t size = sizeof( struct JournalHeader ) + count * sizeof( struct JournalRecord );
+    char *data = ( char * ) statsMalloc( size );
+    makeHeader( ( struct JournalHeader * ) data );
+
+    struct JournalRecord *record =
+        ( struct JournalRecord * ) ( data + sizeof( struct JournalHeader ) );
+    for ( int n = 0; n < book->open; n++ ) {
+
+        struct Order const *order = book->orders[ n ];
+
+        makeRecord( record++, JOURNAL_OPEN, order->number, NULL, 0 );
+        for ( int i = 0; i < order->count; i++ )
+            makeRecord( record++, JOURNAL_ADD, order->number, order->list[ i ]->menuItem->id,
+                        order->list[ i ]->quantity );
+    }
+
+    if ( book->current )
+        makeRecord( record++, JOURNAL_SWITCH, book->current, NULL, 0 );
+
+    bool ok = writeAll( fd, data, size ) && fdatasync( fd ) == 0 &&
+              rename( tmpName, journal->filename ) == 0;
+    statsFree( data );
+
+    if ( !ok ) {
+        close( fd );
+        unlink( tmpName );
+        statsFree( tmpName );
+        return false;
+    }
+
+    // the rename itself is only durable once the directory is synced
+    syncDirectory( journal->filename );
+
+    close( journal->fd );
+    journal->fd = fd;
+    journal->records = count;
+    journal->unsynced = 0;
+    if ( journal->compactAt < 2 * count )
+        journal->compactAt = 2 * count;
+    if ( journal->compactAt < JOURNAL_COMPACT_RECORDS )
+        journal->compactAt = JOURNAL_COMPACT_RECORDS;
+
+    statsFree( tmpName );
+    return true;
+}
+
+/**
+    Empties the journal once the session is finished.
+
+    @param *journal Journal to empty
+  */
+void resetJournal( struct Journal *journal ) {
+
+    // the old records would be replayed next time, so say if they're still there
+    if ( ftruncate( journal->fd, sizeof( struct JournalHeader ) ) != 0 ) {
+        fprintf( stderr, "Can't write journal file: %s\n", journal->filename );
+        return;
+    }
+
+    journal->records = 0;
+    syncFile( journal );
+}
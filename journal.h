@@ -0,0 +1,135 @@
+/**
+    @filename journal.h
+    @author Will Greene (wgreene)
+
+    Header file for journal.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+struct Menu;
+struct OrderBook;
+
+/** first bytes of every order journal file */
+#define JOURNAL_MAGIC "KIOSKJNL"
+
+/** version of the journal record layout */
+#define JOURNAL_VERSION 2
+
+/** the journal was opened */
+#define JOURNAL_OK 0
+
+/** the journal file can't be opened or created */
+#define JOURNAL_CANT_OPEN 1
+
+/** the file isn't a journal this program can read */
+#define JOURNAL_INVALID 2
+
+/** most records written before they're synced to disk */
+#define JOURNAL_SYNC_RECORDS 64
+
+/** highest Order number a journal record may hold ( larger ones are corrupt ) */
+#define JOURNAL_MAX_ORDER ( 1 << 24 )
+
+/** fewest records in the journal before it's compacted */
+#define JOURNAL_COMPACT_RECORDS 4096
+
+/**
+    What a journal record says happened.
+  */
+enum JournalOp {
+    JOURNAL_OPEN,   // an Order was opened ( and became the current one )
+    JOURNAL_CLOSE,  // an Order was closed
+    JOURNAL_SWITCH, // an Order became the current one
+    JOURNAL_ADD,    // some of a MenuItem was added to an Order
+    JOURNAL_REMOVE, // some of a MenuItem was taken out of an Order
+};
+
+/**
+    An append-only file of changes to a session's Orders, so they can be
+    rebuilt if the process dies. Every record is written to the file as the
+    change is made; syncing it to disk is grouped, by record count, and done
+    whenever the session is about to wait for input ( see syncJournal() ).
+  */
+struct Journal {
+    int fd;                 // the journal file ( opened for appending )
+    char *filename;         // name of the journal file
+    long long records;      // number of records in the file
+    int unsynced;           // records written since the last sync
+    long long compactAt;    // number of records at which the journal is next compacted
+};
+
+/**
+    Opens a journal file, creating it if it doesn't exist. Every record is
+    checked, so replaying the journal can't run into one that makes no sense.
+
+    @param *filename name of the journal file
+    @param **journal set to the Journal ( free it with freeJournal() )
+    @return JOURNAL_OK, JOURNAL_CANT_OPEN, or JOURNAL_INVALID if the file
+            isn't a journal this program can read or holds a record it can't
+            replay
+  */
+int openJournal( char const *filename, struct Journal **journal );
+
+/**
+    Syncs and closes a journal file, and frees the memory used to store the
+    Journal.
+
+    @param *journal Journal to be freed
+  */
+void freeJournal( struct Journal *journal );
+
+/**
+    Syncs the records written since the last sync to disk, if there are any.
+    Sessions call this when they run out of input, so the sync happens while
+    nobody is waiting on a reply and no record stays unsynced while the
+    session is idle.
+
+    @param *journal Journal to sync
+  */
+void syncJournal( struct Journal *journal );
+
+/**
+    Rebuilds a session's Orders from the journal, then compacts the journal.
+    Items that are no longer on the menu are dropped, and a record cut short
+    by a crash is ignored.
+
+    @param *journal Journal to replay
+    @param *book OrderBook to open the Orders in ( normally empty )
+    @param *menu Menu to find the items on
+  */
+void replayJournal( struct Journal *journal, struct OrderBook *book, struct Menu *menu );
+
+/**
+    Records a change that has just been made to a session's Orders. The
+    journal is compacted each time it doubles in size since it was last
+    compacted.
+
+    @param *journal Journal to write to
+    @param *book OrderBook that was changed
+    @param op what happened
+    @param number number of the Order it happened to
+    @param *id id of the MenuItem added or removed ( NULL for the other ops )
+    @param quantity how many were added or removed ( 0 for the other ops )
+  */
+void journalRecord( struct Journal *journal, struct OrderBook const *book, enum JournalOp op,
+                    int number, char const *id, int quantity );
+
+/**
+    Rewrites the journal as the open Orders and their items, followed by
+    which Order is current, under a temporary name that is then renamed into
+    place.
+
+    @param *journal Journal to compact
+    @param *book OrderBook the journal is for
+    @return true if the journal was rewritten
+  */
+bool compactJournal( struct Journal *journal, struct OrderBook const *book );
+
+/**
+    Empties the journal once the session is finished.
+
+    @param *journal Journal to empty
+  */
+void resetJournal( struct Journal *journal );
@@ -9,375 +9,283 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "input.h"
 #include "menu.h"
+#include "order.h"
+#include "command.h"
+#include "server.h"
+#include "snapshot.h"
+#include "reload.h"
+#include "stats.h"
+#include "check.h"
+#include "journal.h"
+#include "ticket.h"
 
 /** number of required arguments at the end of the command line. */
 #define REQUIRED_ARGS 1
 
-/** initial number of Order array elements */
-#define ORDER_INITIAL_CAPACITY 5
+/** size of the stdout buffer in batch mode */
+#define BATCH_OUTPUT_BUFFER_SIZE ( 1 << 20 )
 
-/** maximum number of characters for user input */
-#define MAX_NUM_CHARS_INPUT 100
+/** usage message for bad command lines */
+#define USAGE "usage: kiosk <menu-file>*\n"
 
 /**
-    An order item.
-  */
-struct OrderItem {
-    struct MenuItem *menuItem; // order item characteristics ( pointer to a MenuItem struct )
-    int quantity;              // quantity of this type of order item
-};
-
-/**
-    An order.
-  */
-struct Order {
-    struct OrderItem **list; // list of order items
-    int count;               // number of order items
-    int capacity;            // capacity of the list
-};
-
-/**
-    Helper function for qsort(). Compares 2 pointers ( MenuItem's in this case ) to
-    determine order ( based on category, then id, in this case ).
-    
-    @param *aptr void pointer ( to a MenuItem in this case )
-    @param *bptr void pointer ( to a MenuItem in this case )
-    @return a negative number if *aptr comes before *bptr,
-            a positive number if *bptr comes before *aptr,
-            and 0 if the pointers are identical
-  */
-int listMenuComp( const void *aptr, const void *bptr )
-{
-    const struct MenuItem *a = *(const struct MenuItem **) aptr;
-    const struct MenuItem *b = *(const struct MenuItem **) bptr;
+    Starting point. Contains command line error checking. Contains functionality for
+    interacting with the program until the user / input selects to quit the program.
     
-    if ( strcmp( a->category, b->category ) != 0 )
-        return strcmp( a->category, b->category );
+    Options ( before the menu files ):
+      --batch          read commands in large blocks and buffer all output,
+                       without prompts
+      --prompt         print prompts in batch mode anyway
+      --script <file>  run the commands in a file ( may be repeated, implies
+                       --batch ); each script gets its own order
+      --server <path>  load the menu once and serve sessions over a Unix-domain
+                       socket at path
+      --connect <path> pass standard input to a --server at path and its
+                       replies to standard output ( no menu files )
+      --compile <file> check and sort the menu files, write them to a binary
+                       snapshot file, and exit
+      --snapshot <file> load the menu from a snapshot file written by
+                       --compile instead of from menu files
+      --watch          reload the menu whenever its files change, keeping
+                       every open order
+      --stats          count and time commands and allocations ( shown by
+                       the stats command, and on standard error at exit )
+      --check          report every problem in the menu files as file:line,
+                       then exit ( with a failure status if there were any )
+      --journal <file> record the orders in a journal file, and start from the
+                       orders it holds ( emptied by quit; not with --server,
+                       or with more than one --script, since every script
+                       would start from the orders the last one left open )
+      --tickets <file> append kitchen tickets for checked-out orders to a file
+                       ( standard output if not given )
     
-    if ( strcmp( a->id, b->id ) != 0 )
-        return strcmp( a->id, b->id );
-        
-    return 0;
-}
-
-/**
-    Helper function for qsort(). Compares 2 pointers ( MenuItem's in this case ) to
-    determine order ( based on id, in this case ).
-        
-    @param *aptr void pointer ( to a MenuItem in this case )
-    @param *bptr void pointer ( to a MenuItem in this case )
-    @return a negative number if *aptr comes before *bptr,
-            a positive number if *bptr comes before *aptr,
-            and 0 if the pointers are identical
-  */
-int listCategoryComp( const void *aptr, const void *bptr )
-{
-    const struct MenuItem *a = *(const struct MenuItem **) aptr;
-    const struct MenuItem *b = *(const struct MenuItem **) bptr;
-            
-    return strcmp( a->id, b->id );
-}
-
-/**
-    Helper function for qsort(). Compares 2 pointers ( OrderItem's in this case ) to
-    determine order ( based on cost * quantity, then id, in this case ).
-    
-    @param *va void pointer ( to an OrderItem in this case )
-    @param *vb void pointer ( to an OrderItem in this case )
-    @return a negative number if *va comes before *vb,
-            a positive number if *vb comes before *va,
-            and 0 if the pointers are identical
+    @param argc number of arguments
+    @param *argv[] array of pointers to command line arguments
+    @return exit status
   */
-int listOrderComp( void const *va, void const *vb )
-{
-    const struct OrderItem *a = *(const struct OrderItem **) va;
-    const struct OrderItem *b = *(const struct OrderItem **) vb;
-    
-    if ( a->menuItem->cost * a->quantity > b->menuItem->cost * b->quantity )
-        return -1;
-    
-    if ( a->menuItem->cost * a->quantity < b->menuItem->cost * b->quantity )
-        return 1;
-    
-    return strcmp( a->menuItem->id, b->menuItem->id );
-}
-
-/**
-    Determines whether a MenuItem belongs to the given category.
+int main( int argc, char *argv[] ) {
     
-    @param *item MenuItem to compare to category
-    @param *str category
-    @return true if it belongs, false if not
-  */
-bool isCategory( struct MenuItem const *item, char const *str )
-{
-    char const *p1 = item->category;
-    char const *p2 = str;
-
-    while ( *p2 ) {
+    bool batch = false;
+    bool prompt = false;
+    char const *serverPath = NULL;
+    char const *connectPath = NULL;
+    char const *compilePath = NULL;
+    char *snapshotPath = NULL;
+    bool watch = false;
+    bool check = false;
+    char const *journalPath = NULL;
+    char const *ticketsPath = NULL;
+    char **scripts = ( char ** ) malloc( argc * sizeof( char * ) );
+    int scriptCount = 0;
     
-        if ( *p1 != *p2 )
-            return false;
-            
-        p1++;
-        p2++;
+    int arg = 1;
+    for ( ; arg < argc && strncmp( argv[ arg ], "--", 2 ) == 0; arg++ ) {
+        if ( strcmp( argv[ arg ], "--batch" ) == 0 )
+            batch = true;
+        else if ( strcmp( argv[ arg ], "--prompt" ) == 0 )
+            prompt = true;
+        else if ( strcmp( argv[ arg ], "--script" ) == 0 && arg + 1 < argc ) {
+            batch = true;
+            scripts[ scriptCount++ ] = argv[ ++arg ];
+        } else if ( strcmp( argv[ arg ], "--server" ) == 0 && arg + 1 < argc )
+            serverPath = argv[ ++arg ];
+        else if ( strcmp( argv[ arg ], "--connect" ) == 0 && arg + 1 < argc )
+            connectPath = argv[ ++arg ];
+        else if ( strcmp( argv[ arg ], "--compile" ) == 0 && arg + 1 < argc )
+            compilePath = argv[ ++arg ];
+        else if ( strcmp( argv[ arg ], "--snapshot" ) == 0 && arg + 1 < argc )
+            snapshotPath = argv[ ++arg ];
+        else if ( strcmp( argv[ arg ], "--watch" ) == 0 )
+            watch = true;
+        else if ( strcmp( argv[ arg ], "--stats" ) == 0 )
+            statsEnabled = true;
+        else if ( strcmp( argv[ arg ], "--check" ) == 0 )
+            check = true;
+        else if ( strcmp( argv[ arg ], "--journal" ) == 0 && arg + 1 < argc )
+            journalPath = argv[ ++arg ];
+        else if ( strcmp( argv[ arg ], "--tickets" ) == 0 && arg + 1 < argc )
+            ticketsPath = argv[ ++arg ];
+        else {
+            fprintf( stderr, USAGE );
+            exit( EXIT_FAILURE );
+        }
     }
     
-    if ( *p1 != *p2 )
-        return false;
-    
-    return true;
-}
-
-/**
-    Sorts the OrderItems in the given Order and then prints them.
+    if ( connectPath ) {
+        if ( argc - arg != 0 ) {
+            fprintf( stderr, USAGE );
+            exit( EXIT_FAILURE );
+        }
+        
+        free( scripts );
+        if ( !runClient( connectPath ) ) {
+            fprintf( stderr, "Can't connect to socket: %s\n", connectPath );
+            exit( EXIT_FAILURE );
+        }
+        return EXIT_SUCCESS;
+    }
     
-    @param *order Order to print
-    @param *compare pointer to a function that will be passed to qsort()
-  */
-void listOrderItems( struct Order *order, int (*compare)( void const *va, void const *vb )) {
+    // parameter error checking ( a snapshot replaces the menu files )
+    if ( ( snapshotPath ? argc - arg != 0 : argc - arg < REQUIRED_ARGS ) ||
+         ( journalPath && ( serverPath || scriptCount > 1 ) ) ) {
+        fprintf( stderr, USAGE );
+        exit( EXIT_FAILURE );
+    }
     
-    qsort( order->list, order->count, sizeof( order->list[ 0 ] ), compare );
+    if ( check ) {
+        long long problems = checkMenuFiles( argv + arg, argc - arg, stdout );
+        free( scripts );
+        return problems ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
     
-    printf( "ID   Name                 Quantity Category        Cost\n" );
+    struct Menu *menu;
+    long long start = statsStart();
     
-    if ( order->count == 0 )
-        printf( "Total                                              $  0.00\n\n");
+    if ( snapshotPath ) {
+        int status = loadMenuSnapshot( snapshotPath, &menu );
+        
+        if ( status == MENU_CANT_OPEN ) {
+            fprintf( stderr, "Can't open file: %s\n", snapshotPath );
+            exit( EXIT_FAILURE );
+        }
+        
+        if ( status == MENU_INVALID ) {
+            fprintf( stderr, "Invalid menu file: %s\n", snapshotPath );
+            exit( EXIT_FAILURE );
+        }
+    }
     
     else {
+        menu = makeMenu();
         
-        float sumCost = 0.0;
-        for ( int i = 0; i < order->count; i++ ) {
+        // watched files may be rewritten while they are read
+        int bad;
+        int status = readMenuFiles( argv + arg, argc - arg, menu, &bad, !watch );
         
-            printf( "%-5s",   order->list[ i ]->menuItem->id );
-            printf( "%-21s",  order->list[ i ]->menuItem->name );
-            printf( "%8d ",   order->list[ i ]->quantity );
-            printf( "%-16s",  order->list[ i ]->menuItem->category );
-            
-            float cost = order->list[ i ]->menuItem->cost * order->list[ i ]->quantity / 
-                         CENTS_IN_A_DOLLAR;
-                         
-            printf( "$%6.2f\n", cost );
-            
-            sumCost += cost;
+        if ( status == MENU_CANT_OPEN ) {
+            fprintf( stderr, "Can't open file: %s\n", argv[ arg + bad ] );
+            exit( EXIT_FAILURE );
         }
         
-        printf( "Total                                              $%6.2f\n\n", sumCost );
+        if ( status == MENU_INVALID ) {
+            fprintf( stderr, "Invalid menu file: %s\n", argv[ arg + bad ] );
+            exit( EXIT_FAILURE );
+        }
+        
+        sortMenuItems( menu );
     }
-}
-
-/**
-    Starting point. Contains command line error checking. Contains functionality for
-    interacting with the program until the user / input selects to quit the program.
     
-    @param argc number of arguments
-    @param *argv[] array of pointers to command line arguments
-    @return exit status
-  */
-int main( int argc, char *argv[] ) {
+    statsStop( STATS_LOAD_MENU, start );
     
-    // parameter error checking
-    if ( argc < REQUIRED_ARGS + 1 ) {
-        fprintf( stderr, "usage: kiosk <menu-file>*\n" );
-        exit( EXIT_FAILURE );
+    if ( compilePath ) {
+        if ( !writeMenuSnapshot( menu, compilePath ) ) {
+            fprintf( stderr, "Can't write file: %s\n", compilePath );
+            exit( EXIT_FAILURE );
+        }
+        
+        free( scripts );
+        freeMenu( menu );
+        return EXIT_SUCCESS;
     }
     
-    struct Menu *menu = makeMenu();
+    struct Journal *journal = NULL;
     
-    for ( int i = 1; i < argc; i++ )
-        readMenuItems( argv[ i ], menu );
+    if ( journalPath ) {
+        int status = openJournal( journalPath, &journal );
         
-    struct Order *order = (struct Order *) malloc( sizeof( struct Order ) );
+        if ( status == JOURNAL_CANT_OPEN ) {
+            fprintf( stderr, "Can't open file: %s\n", journalPath );
+            exit( EXIT_FAILURE );
+        }
+        
+        if ( status == JOURNAL_INVALID ) {
+            fprintf( stderr, "Invalid journal file: %s\n", journalPath );
+            exit( EXIT_FAILURE );
+        }
+    }
     
-    order->list = ( struct OrderItem ** ) malloc(ORDER_INITIAL_CAPACITY * 
-                  sizeof( struct OrderItem * ));
-                  
-    order->count = 0;
-    order->capacity = ORDER_INITIAL_CAPACITY;
+    FILE *ticketsFile = stdout;
+    if ( ticketsPath && !( ticketsFile = fopen( ticketsPath, "a" ) ) ) {
+        fprintf( stderr, "Can't open file: %s\n", ticketsPath );
+        exit( EXIT_FAILURE );
+    }
     
-    // command 1 options
-    char cList[] = "list";
-    char cAdd[] = "add";
-    char cRemove[] = "remove";
-    char cQuit[] = "quit";
+    struct TicketQueue *tickets = makeTicketQueue( ticketsFile );
+    if ( !tickets ) {
+        fprintf( stderr, "Can't start the kitchen thread\n" );
+        exit( EXIT_FAILURE );
+    }
     
-    // command 2 options ( if command 1 is "list" )
-    char cMenu[] = "menu";
-    char cCategory[] = "category";
-    char cOrder[] = "order";
+    struct MenuSource *source = makeMenuSource( menu );
     
-    bool quit = false;
+    if ( watch && !( snapshotPath ? watchMenuFiles( source, &snapshotPath, 1, true ) :
+                     watchMenuFiles( source, argv + arg, argc - arg, false ) ) ) {
+        fprintf( stderr, "Can't watch menu files\n" );
+        exit( EXIT_FAILURE );
+    }
     
-    int itemRemoved = 0;
+    if ( serverPath ) {
+        if ( !runServer( source, tickets, serverPath ) ) {
+            fprintf( stderr, "Can't serve on socket: %s\n", serverPath );
+            exit( EXIT_FAILURE );
+        }
+    }
     
-    while ( !quit ) {
+    else if ( !batch ) {
+        struct LineReader *reader = makeLineReader( STDIN_FILENO );
+        runSession( source, journal, tickets, reader, stdout, true, true );
+        freeLineReader( reader );
+    }
     
-        char input [ MAX_NUM_CHARS_INPUT ] = {};
-        char input1[ MAX_NUM_CHARS_INPUT ] = {};
-        char input2[ MAX_NUM_CHARS_INPUT ] = {};
-        char input3[ MAX_NUM_CHARS_INPUT ] = {};
-        
-        printf( "cmd> " );
-        
-        char ch;
-        int idx = 0;
-        while( scanf( "%c", &ch ) == 1 ) {
-        
-            if ( ch == '\n' )
-                goto out;
-                
-            input[ idx ] = ch;
-            idx++;
-        }
-        
-        goto end;
-        
-        out:
-        input[ idx ] = '\0';
-        
-        int pos2 = 0;
-        sscanf( input, "%s%n", input1, &pos2 );
-        
-        int pos3 = 0;
-        sscanf( input + pos2, "%s%n", input2, &pos3 );
-        
-        sscanf( input + pos2 + pos3, "%s", input3 );
-        
-        if ( strcmp( input1, cList ) == 0 && strcmp( input2, cMenu ) == 0 && input3[ 0 ] != '\0' )
-            goto else1;
+    else {
+    
+        setvbuf( stdout, NULL, _IOFBF, BATCH_OUTPUT_BUFFER_SIZE );
         
-        // list ( print ) items
-        if ( strcmp( input1, cList ) == 0 ) {
-            if ( strcmp( input2, cMenu ) == 0 )
-                listMenuItems( menu, *listMenuComp, isCategory, input );
-            else if ( strcmp( input2, cCategory ) == 0 )
-                listMenuItems( menu, listCategoryComp, isCategory, input3 );
-            else if ( strcmp( input2, cOrder ) == 0 ) {
-                printf( "%s\n", input );
-                listOrderItems( order, listOrderComp );
-            } else
-                printf( "Invalid command\n" );
+        if ( scriptCount == 0 ) {
+            struct LineReader *reader = makeLineReader( STDIN_FILENO );
+            runSession( source, journal, tickets, reader, stdout, prompt, false );
+            freeLineReader( reader );
         }
-            
-        // add item
-        else if ( strcmp( input1, cAdd ) == 0 ) {
         
-            // if already in order
-            for ( int i = 0; i < order->count; i++ ) {
-                if ( strcmp( input2, order->list[ i ]->menuItem->id ) == 0 ) {
-                    int q = atoi( input3 );
-                    if ( q < 1 ) {
-                        printf( "Invalid command\n" );
-                        goto print2;
-                    } else {
-                        order->list[ i ]->quantity += q;
-                        goto print1;
-                    }
-                }
-            }
-            
-            bool found = false;
-            // if not already in order
-            for ( int i = 0; i < menu->count; i++ ) {
-                if ( strcmp( input2, menu->list[ i ]->id ) == 0 ) {
-                    int q = atoi( input3 );
-                    if ( q < 1 ) {
-                        printf( "Invalid command" );
-                        goto print2;
-                    } else {
-                        order->list[ order->count ] = (struct OrderItem *)
-                                                      malloc( sizeof( struct OrderItem ) );
-                                                      
-                        order->list[ order->count ]->quantity = q;
-                        order->list[ order->count ]->menuItem = menu->list[ i ];
-                        (order->count)++;
-                        itemRemoved = 0;
-                        if ( order->count >= order->capacity ) {
-                            order->capacity *= 2;
-                            order->list = realloc( order->list, sizeof( struct OrderItem * ) *
-                                          order->capacity );
-                        }
-                    }
-                    
-                    found = true;
-                }
-            }
-            
-            if ( !found )
-                goto else1;
-            
-            print1:
-            printf( input );
-            printf( "\n" );
-            print2:
-            printf( "\n" );
-        }
-            
-        // remove item
-        else if ( strcmp( input1, cRemove ) == 0 ) {
+        for ( int i = 0; i < scriptCount; i++ ) {
         
-            bool found2 = false;
-            for ( int i = 0; i < order->count; i++ ) {
-                if ( strcmp( order->list[ i ]->menuItem->id, input2 ) == 0 ) {
-                    int q = atoi( input3 );
-                    if ( q == order->list[ i ]-> quantity ) {
-                    
-                        free( order->list[ i ] );
-                        for ( int j = i; j < order->count - 1; j++ )
-                            order->list[ j ] = order->list[ j + 1 ];
-                        order->list[ order->count - 1 ] = NULL;
-                        (order->count)--;
-                        itemRemoved = 1;
-                        goto print3;
-                        
-                    } else if ( q < order->list[ i ]->quantity ) {
-                        order->list[ i ]->quantity -= q;
-                        goto print3;
-                    
-                    } else {
-                        printf( "Invalid command\n" );
-                        goto print4;
-                    }
-                }
-                
-                found2 = true;
+            int fd = open( scripts[ i ], O_RDONLY );
+            if ( fd < 0 ) {
+                fflush( stdout );
+                fprintf( stderr, "Can't open file: %s\n", scripts[ i ] );
+                exit( EXIT_FAILURE );
             }
             
-            if ( !found2 )
-                goto else1;
-            
-            print3:
-            printf( input );
-            printf( "\n" );
-            print4:
-            printf( "\n" );
-        }
-            
-        // quit
-        else if ( strcmp( input1, cQuit ) == 0 ) {
-            quit = true;
-            printf( "quit\n" );
-        }
-        
-        else {
-            else1:
-            printf( "%s\n", input );
-            printf( "Invalid command\n\n" );
+            struct LineReader *reader = makeLineReader( fd );
+            runSession( source, journal, tickets, reader, stdout, prompt, false );
+            freeLineReader( reader );
+            close( fd );
         }
     }
     
-    end:
+    free( scripts );
+    if ( journal )
+        freeJournal( journal );
+    freeMenuSource( source );
     
-    for ( int i = 0; i < order->count + itemRemoved ; i++ )
-        free( order->list[ i ] );
-        
-    free( order->list );
-    free( order );
+    // tickets still waiting are printed before the stats that count them
+    stopTicketQueue( tickets );
+    
+    if ( statsEnabled ) {
+        fflush( stdout );
+        printStats( stderr );
+        printTicketStats( tickets, stderr );
+    }
+    
+    freeTicketQueue( tickets );
     
-    freeMenu( menu );
+    if ( ticketsFile != stdout )
+        fclose( ticketsFile );
                 
     return EXIT_SUCCESS;
 }
@@ -6,6 +6,17 @@
   */
 #include "menu.h"
 #include "input.h"
+#include "stats.h"
+#include "sort.h"
+#include "search.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /**
     Allocates storage for a (the) Menu, and initializes its fields.
@@ -14,11 +25,36 @@
   */
 struct Menu *makeMenu() {
 
-    struct Menu *menu = ( struct Menu * ) malloc( sizeof( struct Menu ) );
+    struct Menu *menu = ( struct Menu * ) statsMalloc( sizeof( struct Menu ) );
     
-    menu->list = ( struct MenuItem ** ) malloc(MENU_INITIAL_CAPACITY * sizeof( struct MenuItem * ));
+    menu->items = ( struct MenuItem * ) statsMalloc( MENU_INITIAL_CAPACITY *
+                  sizeof( struct MenuItem ) );
     menu->count = 0;
     menu->capacity = MENU_INITIAL_CAPACITY;
+    menu->menuView = NULL;
+    menu->idView = NULL;
+    
+    menu->index = ( int * ) statsCalloc( MENU_INDEX_INITIAL_SIZE, sizeof( int ) );
+    menu->indexSize = MENU_INDEX_INITIAL_SIZE;
+    
+    menu->categories = NULL;
+    menu->categoryCount = 0;
+    menu->categoryCapacity = 0;
+    menu->categoryIndex = ( int * ) statsCalloc( CATEGORY_INDEX_INITIAL_SIZE, sizeof( int ) );
+    menu->categoryIndexSize = CATEGORY_INDEX_INITIAL_SIZE;
+    menu->categoryStart = NULL;
+    menu->rows = NULL;
+    menu->rowStart = NULL;
+    menu->idRow = NULL;
+    menu->costRows = NULL;
+    menu->categoryCostRows = NULL;
+    menu->gramKeys = NULL;
+    menu->gramCount = 0;
+    menu->gramStart = NULL;
+    menu->postings = NULL;
+    menu->snapshot = NULL;
+    menu->snapshotSize = 0;
+    menu->references = 0;
     
     return menu;
 }
@@ -30,181 +66,936 @@ struct Menu *makeMenu() {
   */
 void freeMenu( struct Menu *menu ) {
 
-    for ( int i = 0; i < menu->count; i++ ) {
-        free( menu->list[ i ] );
+    // a loaded snapshot owns all of the arrays
+    if ( menu->snapshot ) {
+        munmap( menu->snapshot, menu->snapshotSize );
+        statsFree( menu );
+        return;
     }
+
+    statsFree( menu->items );
+    statsFree( menu->menuView );
+    statsFree( menu->idView );
+    statsFree( menu->index );
+    statsFree( menu->categories );
+    statsFree( menu->categoryIndex );
+    statsFree( menu->categoryStart );
+    statsFree( menu->rows );
+    statsFree( menu->rowStart );
+    statsFree( menu->idRow );
+    statsFree( menu->costRows );
+    statsFree( menu->categoryCostRows );
+    statsFree( menu->gramKeys );
+    statsFree( menu->gramStart );
+    statsFree( menu->postings );
+    statsFree( menu );
+}
+
+/**
+    Packs a MenuItem id into an integer. Keys compare in the same order as the
+    ids do with strcmp().
     
-    free( menu->list );
-    free( menu );
+    @param *id id to pack ( NUM_CHAR_ID - 1 characters )
+    @return the packed id
+  */
+unsigned int menuItemKey( char const *id ) {
+
+    unsigned char const *u = (unsigned char const *) id;
+    
+    return ( (unsigned int) u[ 0 ] << 24 ) | ( (unsigned int) u[ 1 ] << 16 ) |
+           ( (unsigned int) u[ 2 ] << 8 ) | u[ 3 ];
 }
 
 /**
-    Reads all MenuItems from a file with the given name.
+    Scrambles a packed id so that ids differing only in a few characters
+    spread across a whole hash table.
     
-    @param *filename name of file to read from
-    @param *menu Menu to add to
+    @param key packed id ( from menuItemKey() )
+    @return hash of the key
   */
-void readMenuItems( char const *filename, struct Menu *menu ) {
+unsigned int hashMenuItemKey( unsigned int key ) {
+
+    key ^= key >> 16;
+    key *= 0x85ebca6bu;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35u;
+    key ^= key >> 16;
     
-    FILE *fp = fopen( filename, "r" );
+    return key;
+}
+
+/**
+    Finds the index slot that holds the MenuItem with the given id, or the
+    empty slot where it would go.
     
-    if ( !fp ) {
-        fprintf( stderr, "Can't open file: %s\n", filename );
-        exit( EXIT_FAILURE );
-    }
+    @param *menu Menu to search
+    @param *id id to look for
+    @return the slot
+  */
+static int *findSlot( struct Menu const *menu, char const *id ) {
+
+    unsigned int key = menuItemKey( id );
+    unsigned int mask = menu->indexSize - 1;
+    unsigned int i = hashMenuItemKey( key ) & mask;
+    
+    // linear probing
+    while ( menu->index[ i ] && menuItemKey( menu->items[ menu->index[ i ] - 1 ].id ) != key )
+        i = ( i + 1 ) & mask;
         
-    char *str = readLine( fp );
+    return &menu->index[ i ];
+}
+
+/**
+    Finds the MenuItem with the given id in constant time.
     
-    while ( str ) {
+    @param *menu Menu to search
+    @param *id id to look for
+    @return the MenuItem, or NULL if the Menu doesn't have one with that id
+  */
+struct MenuItem *findMenuItem( struct Menu const *menu, char const *id ) {
+
+    // only 4-character ids can be in the menu
+    if ( strlen( id ) != NUM_CHAR_ID - 1 )
+        return NULL;
+        
+    int slot = *findSlot( menu, id );
     
-        char *strPlaceholder = str;
+    return slot ? &menu->items[ slot - 1 ] : NULL;
+}
+
+/**
+    Doubles the size of the id index, rehashing every MenuItem into it.
     
-        // capacity check ( double if at or above capacity )
-        if ( menu->count >= menu->capacity ) {
-            menu->capacity *= 2;
-            menu->list = realloc( menu->list, sizeof( struct MenuItem * ) * menu->capacity );
-        }
+    @param *menu Menu whose index should grow
+  */
+static void growIndex( struct Menu *menu ) {
+
+    int *old = menu->index;
+    int oldSize = menu->indexSize;
+    
+    menu->indexSize *= 2;
+    menu->index = ( int * ) statsCalloc( menu->indexSize, sizeof( int ) );
+    
+    for ( int i = 0; i < oldSize; i++ ) {
+        if ( old[ i ] )
+            *findSlot( menu, menu->items[ old[ i ] - 1 ].id ) = old[ i ];
+    }
+    
+    statsFree( old );
+}
+
+/**
+    Hashes a category name ( FNV-1a ).
+    
+    @param *name category name
+    @return hash of the name
+  */
+static unsigned int hashName( char const *name ) {
+
+    unsigned int hash = 2166136261u;
+    
+    while ( *name ) {
+        hash ^= (unsigned char) *name++;
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+/**
+    Finds the category index slot that holds the given name, or the empty
+    slot where it would go.
+    
+    @param *menu Menu to search
+    @param *name category name
+    @return the slot
+  */
+static int *findCategorySlot( struct Menu const *menu, char const *name ) {
+
+    unsigned int mask = menu->categoryIndexSize - 1;
+    unsigned int i = hashName( name ) & mask;
+    
+    // linear probing
+    while ( menu->categoryIndex[ i ] &&
+            strcmp( menu->categories[ menu->categoryIndex[ i ] - 1 ], name ) != 0 )
+        i = ( i + 1 ) & mask;
         
-        // malloc
-        menu->list[ menu->count ] = (struct MenuItem *) calloc( 1, sizeof( struct MenuItem ) );
+    return &menu->categoryIndex[ i ];
+}
+
+/**
+    Finds the interned id of the category with the given name.
+    
+    @param *menu Menu to search
+    @param *name category name
+    @return the category id, or -1 if no MenuItem has that category
+  */
+int findCategory( struct Menu const *menu, char const *name ) {
+
+    if ( strlen( name ) >= MAX_NUM_CHAR_CATEGORY )
+        return -1;
         
-        // id assignment
-        int pos1 = 0;
-        sscanf( str, "%s%n", menu->list[ menu->count ]->id, &pos1 );
+    return *findCategorySlot( menu, name ) - 1;
+}
+
+/**
+    Returns the interned id of the given category name, adding it to the
+    Menu's categories if it's new.
+    
+    @param *menu Menu to add to
+    @param *name category name
+    @return the category id
+  */
+static int internCategory( struct Menu *menu, char const *name ) {
+
+    int *slot = findCategorySlot( menu, name );
+    if ( *slot )
+        return *slot - 1;
         
-        for ( int i = 0; i < NUM_CHAR_ID; i++ ) {
+    // capacity check ( double if at or above capacity )
+    if ( menu->categoryCount >= menu->categoryCapacity ) {
+        menu->categoryCapacity = menu->categoryCapacity ? menu->categoryCapacity * 2 :
+                                 MENU_INITIAL_CAPACITY;
+        menu->categories = statsRealloc( menu->categories,
+                                    sizeof( menu->categories[ 0 ] ) * menu->categoryCapacity );
+    }
+    
+    strcpy( menu->categories[ menu->categoryCount ], name );
+    *slot = ++( menu->categoryCount );
+    
+    // keep the index at most half full
+    if ( menu->categoryCount * 2 > menu->categoryIndexSize ) {
+    
+        int *old = menu->categoryIndex;
+        int oldSize = menu->categoryIndexSize;
         
-            if ( menu->list[ menu->count ]->id[ 0 ] == '\0' ||
-                 menu->list[ menu->count ]->id[ 1 ] == '\0' ||
-                 menu->list[ menu->count ]->id[ 2 ] == '\0' ||
-                 menu->list[ menu->count ]->id[ 3 ] == '\0' ||
-                 menu->list[ menu->count ]->id[ 4 ] != '\0' ) {
-             
-                fprintf( stderr, "Invalid menu file: %s\n", filename );
-                exit( EXIT_FAILURE );
-            }
-        }
+        menu->categoryIndexSize *= 2;
+        menu->categoryIndex = ( int * ) statsCalloc( menu->categoryIndexSize, sizeof( int ) );
         
-        for ( int i = 0; i < menu->count; i++ ) {
-            if ( strcmp( menu->list[ menu->count ]->id, menu->list[ i ]->id ) == 0 ) {
-                fprintf( stderr, "Invalid menu file: %s\n", filename );
-                exit( EXIT_FAILURE );
-            }
+        for ( int i = 0; i < oldSize; i++ ) {
+            if ( old[ i ] )
+                *findCategorySlot( menu, menu->categories[ old[ i ] - 1 ] ) = old[ i ];
         }
         
-        // category assignment
-        int pos2 = 0;
-        sscanf( str + pos1, "%s%n", menu->list[ menu->count ]->category, &pos2 );
+        statsFree( old );
+    }
+    
+    return menu->categoryCount - 1;
+}
+
+/**
+    Parses one line of a menu file into the given MenuItem. Fields are read
+    straight from the line's bytes, which do not need to be null terminated.
+    
+    @param *p first character of the line
+    @param *end one past the last character of the line ( not including the newline )
+    @param *item MenuItem to fill in
+    @return LINE_OK if the line is a valid menu item, or the LINE_ code of the
+            first rule it breaks
+  */
+int parseMenuLine( char const *p, char const *end, struct MenuItem *item ) {
+
+    // id ( exactly NUM_CHAR_ID - 1 characters )
+    while ( p < end && isspace( (unsigned char) *p ) )
+        p++;
+    if ( p == end )
+        return LINE_BLANK;
+    char const *tok = p;
+    while ( p < end && !isspace( (unsigned char) *p ) )
+        p++;
         
-        bool good = false;
-        for ( int i = 0; i <= MAX_NUM_CHAR_CATEGORY; i++ ) {
-            if ( menu->list[ menu->count ]->category[ i ] == '\0' )
-                good = true;
-        }
+    if ( p - tok != NUM_CHAR_ID - 1 )
+        return LINE_BAD_ID;
         
-        if ( !good ) {
-            fprintf( stderr, "Invalid menu file: %s\n", filename );
-            exit( EXIT_FAILURE );
-        }
+    memcpy( item->id, tok, NUM_CHAR_ID - 1 );
+    item->id[ NUM_CHAR_ID - 1 ] = '\0';
+    
+    // category
+    while ( p < end && isspace( (unsigned char) *p ) )
+        p++;
+    tok = p;
+    while ( p < end && !isspace( (unsigned char) *p ) )
+        p++;
         
-        // cost assignment
-        int pos3 = 0;
-        sscanf( str + pos1 + pos2, "%d%n", &menu->list[ menu->count ]->cost, &pos3 );
+    if ( p - tok >= MAX_NUM_CHAR_CATEGORY )
+        return LINE_BAD_CATEGORY;
         
-        if ( menu->list[ menu->count ]->cost <= 0 ) {
-            fprintf( stderr, "Invalid menu file: %s\n", filename );
-            exit( EXIT_FAILURE );
-        }
+    memcpy( item->category, tok, p - tok );
+    item->category[ p - tok ] = '\0';
+    
+    // cost ( a positive whole number of cents )
+    while ( p < end && isspace( (unsigned char) *p ) )
+        p++;
         
-        // name assignment
-        strcpy( str, str + pos1 + pos2 + pos3 );
+    bool negative = false;
+    if ( p < end && ( *p == '+' || *p == '-' ) ) {
+        negative = *p == '-';
+        p++;
+    }
+    
+    if ( p == end || !isdigit( (unsigned char) *p ) )
+        return LINE_BAD_COST;
         
-        while ( *str == ' ' )
-            str++;
-            
-        if ( *str == '\n' || *str == EOF ) {
-            fprintf( stderr, "Invalid menu file: %s\n", filename );
-            exit( EXIT_FAILURE );
-        }
+    long cost = 0;
+    while ( p < end && isdigit( (unsigned char) *p ) ) {
+        cost = cost * 10 + ( *p - '0' );
+        if ( cost > INT_MAX )
+            return LINE_BAD_COST;
+        p++;
+    }
+    
+    if ( negative || cost == 0 )
+        return LINE_BAD_COST;
         
-        int i = 0;
-        int lastChar = 0;
-        while ( *str && *str != '\n' && *str != EOF && i < MAX_NUM_CHAR_NAME ) {
-            if ( i == MAX_NUM_CHAR_NAME - 1 && *str && *str != '\n' && *str != EOF ) {
-                fprintf( stderr, "Invalid menu file: %s\n", filename );
-                exit( EXIT_FAILURE );
-            }
-            menu->list[ menu->count ]->name[ i ] = *str;
-            str++;
-            i++;
-            lastChar = i;
-        }
+    item->cost = cost;
+    
+    // name ( the rest of the line after any spaces )
+    while ( p < end && *p == ' ' )
+        p++;
         
-        menu->list[ menu->count ]->name[ lastChar ] = '\0';
+    if ( p == end || end - p >= MAX_NUM_CHAR_NAME )
+        return LINE_BAD_NAME;
         
-        (menu->count)++;
+    memcpy( item->name, p, end - p );
+    item->name[ end - p ] = '\0';
+    
+    return LINE_OK;
+}
 
-        str = strPlaceholder;
-        free( str );
-        str = readLine( fp );
+/**
+    Parses a line of a menu file into a new MenuItem at the end of the Menu's
+    item storage. The item isn't indexed yet ( see indexMenuItems() ).
+    
+    @param *line first character of the line
+    @param *end one past the last character of the line ( not including the newline )
+    @param *menu Menu to add to
+    @return true if the line is valid
+  */
+static bool addMenuItem( char const *line, char const *end, struct Menu *menu ) {
+                         
+    // capacity check ( double if at or above capacity )
+    if ( menu->count >= menu->capacity ) {
+        menu->capacity *= 2;
+        menu->items = statsRealloc( menu->items, sizeof( struct MenuItem ) * menu->capacity );
     }
     
-    fclose( fp );
+    struct MenuItem *item = &menu->items[ menu->count ];
+    memset( item, 0, sizeof( struct MenuItem ) );
+    
+    if ( parseMenuLine( line, end, item ) != LINE_OK )
+        return false;
+        
+    (menu->count)++;
+    return true;
 }
 
 /**
-    Sorts the MenuItems in the given Menu and then prints them.
+    Adds the MenuItems from the given position on to the id index and interns
+    their categories.
     
-    @param *menu Menu to print
-    @param *compare pointer to a function that will be passed to qsort()
-    @param *test pointer to a function that will filter based on category
-    @param *str pointer to standard input string
+    @param *menu Menu to index
+    @param from index of the first MenuItem to add
+    @return false if a MenuItem repeats the id of an earlier one
   */
-void listMenuItems( struct Menu *menu, int (*compare)( void const *va, void const *vb ), 
-bool (*test)( struct MenuItem const *item, char const *str ), char const *str ) {
+static bool indexMenuItems( struct Menu *menu, int from ) {
 
-    qsort( menu->list, menu->count, sizeof( menu->list[ 0 ] ), compare );
+    for ( int i = from; i < menu->count; i++ ) {
+    
+        // keep the index at most half full
+        if ( ( i + 1 ) * 2 > menu->indexSize )
+            growIndex( menu );
+            
+        struct MenuItem *item = &menu->items[ i ];
+        int *slot = findSlot( menu, item->id );
+        
+        if ( *slot )
+            return false;
+            
+        *slot = i + 1;
+        item->categoryId = internCategory( menu, item->category );
+    }
+    
+    return true;
+}
+
+/**
+    Parses every line of a file into MenuItems at the end of the Menu's item
+    storage, without indexing them.
     
-    if ( strcmp( "list menu", str ) == 0 ) {
+    Regular files are memory-mapped and parsed in place. Anything that can't
+    be mapped ( pipes, empty files ), or shouldn't be, is read a line at a
+    time with getLine().
+    
+    @param *filename name of file to read from
+    @param *menu Menu to add to
+    @param map false to read the file even if it could be mapped
+    @return MENU_OK, MENU_CANT_OPEN or MENU_INVALID
+  */
+static int parseMenuFile( char const *filename, struct Menu *menu, bool map ) {
+    
+    int fd = open( filename, O_RDONLY );
+    
+    if ( fd < 0 )
+        return MENU_CANT_OPEN;
+        
+    int status = MENU_OK;
+    
+    struct stat st;
+    if ( map && fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 ) {
+    
+        char *data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        
+        if ( data != MAP_FAILED ) {
+        
+            posix_madvise( data, st.st_size, POSIX_MADV_SEQUENTIAL );
+            
+            char const *p = data;
+            char const *end = data + st.st_size;
+            while ( p < end && status == MENU_OK ) {
+                char const *nl = memchr( p, '\n', end - p );
+                char const *lineEnd = nl ? nl : end;
+                if ( !addMenuItem( p, lineEnd, menu ) )
+                    status = MENU_INVALID;
+                p = nl ? nl + 1 : end;
+            }
             
-        while ( *str ) {
-            putchar( *str );
-            str++;
+            munmap( data, st.st_size );
+            close( fd );
+            return status;
         }
+    }
+    
+    struct LineReader *reader = makeLineReader( fd );
+    
+    // one line buffer is reused for every line in the file
+    char *str = NULL;
+    int strCapacity = 0;
+    int len;
+    
+    while ( status == MENU_OK && ( len = getLine( reader, &str, &strCapacity ) ) >= 0 ) {
+        if ( !addMenuItem( str, str + len, menu ) )
+            status = MENU_INVALID;
+    }
+    
+    if ( len == LINE_ERROR )
+        status = MENU_CANT_OPEN;
+    
+    statsFree( str );
+    freeLineReader( reader );
+    close( fd );
+    return status;
+}
+
+/**
+    Reads all MenuItems from a file with the given name.
+    
+    @param *filename name of file to read from
+    @param *menu Menu to add to
+    @return MENU_OK, MENU_CANT_OPEN if the file can't be opened, or MENU_INVALID
+            if a line is invalid or repeats the id of an earlier MenuItem
+  */
+int readMenuItems( char const *filename, struct Menu *menu ) {
+
+    int from = menu->count;
+    int status = parseMenuFile( filename, menu, true );
+    
+    if ( status == MENU_OK && !indexMenuItems( menu, from ) )
+        status = MENU_INVALID;
+        
+    return status;
+}
+
+/**
+    Files to parse in parallel, shared by the parsing threads.
+  */
+struct ParseJob {
+    char *const *filenames; // files to parse
+    int count;              // number of files
+    struct Menu **partials; // one partial Menu per file
+    int *status;            // parse status of each file
+    int next;               // next file to hand out ( taken atomically )
+    bool map;               // whether the files may be memory-mapped
+};
+
+/**
+    Parsing thread: parses files from the job until none are left.
+    
+    @param *arg the ParseJob
+    @return NULL
+  */
+static void *parseWorker( void *arg ) {
+
+    struct ParseJob *job = arg;
+    int i;
+    
+    while ( ( i = __atomic_fetch_add( &job->next, 1, __ATOMIC_RELAXED ) ) < job->count )
+        job->status[ i ] = parseMenuFile( job->filenames[ i ], job->partials[ i ], job->map );
         
-        putchar( '\n' );
+    return NULL;
+}
+
+/**
+    Reads all MenuItems from the files with the given names. The files are
+    parsed in parallel, then merged in the order given, so the result ( and
+    the file blamed for any error ) is the same as reading them one by one
+    with readMenuItems().
+    
+    A mapped file that shrinks while it is parsed kills the process with
+    SIGBUS, so files that may be rewritten underneath us ( a reload after a
+    change ) should be read instead.
+    
+    @param *filenames names of files to read from
+    @param count number of files
+    @param *menu Menu to add to
+    @param *bad set to the index of the file that caused an error, if any
+    @param map false to read the files instead of memory-mapping them
+    @return MENU_OK, or the readMenuItems() status of the file that caused an error
+  */
+int readMenuFiles( char *const *filenames, int count, struct Menu *menu, int *bad, bool map ) {
+
+    if ( count == 1 ) {
+        *bad = 0;
+        int from = menu->count;
+        int status = parseMenuFile( filenames[ 0 ], menu, map );
+        if ( status == MENU_OK && !indexMenuItems( menu, from ) )
+            status = MENU_INVALID;
+        return status;
+    }
+    
+    struct ParseJob job = { filenames, count, NULL, NULL, 0, map };
+    job.partials = ( struct Menu ** ) statsMalloc( count * sizeof( struct Menu * ) );
+    job.status = ( int * ) statsMalloc( count * sizeof( int ) );
+    for ( int i = 0; i < count; i++ )
+        job.partials[ i ] = makeMenu();
         
-        printf( "ID   Name                 Category        Cost\n" );
+    long cores = sysconf( _SC_NPROCESSORS_ONLN );
+    int threads = count < cores ? count : cores;
+    if ( threads > MENU_MAX_PARSE_THREADS )
+        threads = MENU_MAX_PARSE_THREADS;
+        
+    // this thread parses too
+    pthread_t tids[ MENU_MAX_PARSE_THREADS ];
+    int started = 0;
+    for ( int i = 1; i < threads; i++ ) {
+        if ( pthread_create( &tids[ started ], NULL, parseWorker, &job ) == 0 )
+            started++;
+    }
     
-        for ( int i = 0; i < menu->count; i++ ) {
+    parseWorker( &job );
+    
+    for ( int i = 0; i < started; i++ )
+        pthread_join( tids[ i ], NULL );
         
-            printf( "%-5s",  menu->list[ i ]->id );
-            printf( "%-21s", menu->list[ i ]->name );
-            printf( "%-16s", menu->list[ i ]->category );
+    // merge in command-line order, stopping at the first file with a problem
+    int status = MENU_OK;
+    for ( int i = 0; i < count && status == MENU_OK; i++ ) {
+    
+        struct Menu *partial = job.partials[ i ];
+        *bad = i;
+        status = job.status[ i ];
+        if ( status != MENU_OK )
+            break;
             
-            float cost = menu->list[ i ]->cost / CENTS_IN_A_DOLLAR;
-            printf( "$%6.2f\n", cost );
+        int from = menu->count;
+        if ( from + partial->count > menu->capacity ) {
+            while ( from + partial->count > menu->capacity )
+                menu->capacity *= 2;
+            menu->items = statsRealloc( menu->items, sizeof( struct MenuItem ) * menu->capacity );
         }
+        
+        memcpy( menu->items + from, partial->items, partial->count * sizeof( struct MenuItem ) );
+        menu->count += partial->count;
+        
+        if ( !indexMenuItems( menu, from ) )
+            status = MENU_INVALID;
     }
     
-    else {
+    for ( int i = 0; i < count; i++ )
+        freeMenu( job.partials[ i ] );
+    statsFree( job.partials );
+    statsFree( job.status );
+    
+    return status;
+}
+
+/**
+    Sorts item indexes by packed keys ( see radixSort() ), filling in the
+    indexes from 0 first.
+    
+    @param *view where to store the sorted item indexes
+    @param *keys key of each item ( reordered by the sort )
+    @param count number of items
+  */
+static void sortView( int *view, unsigned long long *keys, int count ) {
+
+    for ( int i = 0; i < count; i++ )
+        view[ i ] = i;
+    
+    radixSort( keys, view, count );
+}
+
+/**
+    Helper function for qsort(). Compares 2 category names.
+    
+    @param *aptr void pointer ( to a category name in this case )
+    @param *bptr void pointer ( to a category name in this case )
+    @return a negative number if *aptr comes before *bptr,
+            a positive number if *bptr comes before *aptr,
+            and 0 if the names are identical
+  */
+static int categoryComp( void const *aptr, void const *bptr ) {
+
+    return strcmp( (char const *) aptr, (char const *) bptr );
+}
+
+/**
+    Sorts the interned categories by name and renumbers the categories of all
+    MenuItems to match, so category ids compare like the names do.
+    
+    @param *menu Menu whose categories should be sorted
+  */
+static void sortCategories( struct Menu *menu ) {
+
+    int n = menu->categoryCount;
+    size_t nameSize = sizeof( menu->categories[ 0 ] );
+    
+    char ( *old )[ MAX_NUM_CHAR_CATEGORY ] = statsMalloc( n * nameSize );
+    memcpy( old, menu->categories, n * nameSize );
+    
+    qsort( menu->categories, n, nameSize, categoryComp );
+    
+    // old id -> new id
+    int *renumber = ( int * ) statsMalloc( n * sizeof( int ) );
+    for ( int i = 0; i < n; i++ ) {
+        char ( *name )[ MAX_NUM_CHAR_CATEGORY ] = bsearch( old[ i ], menu->categories, n, nameSize,
+                                                          categoryComp );
+        renumber[ i ] = name - menu->categories;
+    }
     
-        printf( "list category %s\n", str );
-        printf( "ID   Name                 Category        Cost\n" );
+    for ( int i = 0; i < menu->count; i++ )
+        menu->items[ i ].categoryId = renumber[ menu->items[ i ].categoryId ];
         
-        for ( int i = 0; i < menu->count; i++ ) {
+    // rebuild the index for the new ids
+    memset( menu->categoryIndex, 0, menu->categoryIndexSize * sizeof( int ) );
+    for ( int i = 0; i < n; i++ )
+        *findCategorySlot( menu, menu->categories[ i ] ) = i + 1;
         
-            if ( test( menu->list[ i ], str ) ) {
-                
-                printf( "%-5s",  menu->list[ i ]->id );
-                printf( "%-21s", menu->list[ i ]->name );
-                printf( "%-16s", menu->list[ i ]->category );
-                
-                float cost = menu->list[ i ]->cost / CENTS_IN_A_DOLLAR;
-                printf( "$%6.2f\n", cost );
-            }
+    statsFree( renumber );
+    statsFree( old );
+}
+
+/**
+    Formats the listing row for every MenuItem into one block of text, laid
+    out in menuView order so any category ( or the whole menu ) is a single
+    contiguous run of bytes.
+    
+    @param *menu Menu to render
+  */
+static void renderRows( struct Menu *menu ) {
+
+    statsFree( menu->rows );
+    statsFree( menu->rowStart );
+    menu->rowStart = ( int * ) statsMalloc( ( menu->count + 1 ) * sizeof( int ) );
+    
+    // rows are usually MENU_ROW_LENGTH characters, wider only for very large costs
+    int capacity = menu->count * MENU_ROW_LENGTH + 1;
+    menu->rows = ( char * ) statsMalloc( capacity );
+    
+    int len = 0;
+    for ( int i = 0; i < menu->count; i++ ) {
+    
+        struct MenuItem const *item = &menu->items[ menu->menuView[ i ] ];
+        
+        if ( capacity - len < MENU_MAX_ROW_LENGTH ) {
+            capacity = capacity * 2 + MENU_MAX_ROW_LENGTH;
+            menu->rows = statsRealloc( menu->rows, capacity );
         }
+        
+        menu->rowStart[ i ] = len;
+        
+        float cost = item->cost / CENTS_IN_A_DOLLAR;
+        len += snprintf( menu->rows + len, capacity - len, "%-5s%-21s%-16s$%6.2f\n",
+                         item->id, item->name, item->category, cost );
+    }
+    
+    menu->rowStart[ menu->count ] = len;
+}
+
+/**
+    Builds the sorted views, the pre-rendered listing rows and the name index
+    of the Menu. Call once all files have been read; listings reuse them
+    instead of sorting and formatting again.
+    
+    @param *menu Menu to sort
+  */
+void sortMenuItems( struct Menu *menu ) {
+
+    sortCategories( menu );
+    
+    statsFree( menu->menuView );
+    statsFree( menu->idView );
+    menu->menuView = ( int * ) statsMalloc( menu->count * sizeof( int ) );
+    menu->idView = ( int * ) statsMalloc( menu->count * sizeof( int ) );
+    
+    // packed keys order like the fields they're built from: category ids are
+    // numbered in sorted order by now, and packed ids compare like strcmp()
+    unsigned long long *keys = ( unsigned long long * ) statsMalloc( ( menu->count + 1 ) *
+                               sizeof( unsigned long long ) );
+    
+    // by category, then id
+    for ( int i = 0; i < menu->count; i++ )
+        keys[ i ] = (unsigned long long) menu->items[ i ].categoryId << 32 |
+                    menuItemKey( menu->items[ i ].id );
+    sortView( menu->menuView, keys, menu->count );
+    
+    // by id
+    for ( int i = 0; i < menu->count; i++ )
+        keys[ i ] = menuItemKey( menu->items[ i ].id );
+    sortView( menu->idView, keys, menu->count );
+    
+    // menuView is grouped by category, so each category is one range of it
+    statsFree( menu->categoryStart );
+    menu->categoryStart = ( int * ) statsMalloc( ( menu->categoryCount + 1 ) * sizeof( int ) );
+    
+    int c = 0;
+    for ( int i = 0; i < menu->count; i++ ) {
+        while ( c <= menu->items[ menu->menuView[ i ] ].categoryId )
+            menu->categoryStart[ c++ ] = i;
+    }
+    
+    while ( c <= menu->categoryCount )
+        menu->categoryStart[ c++ ] = menu->count;
+    
+    // where each item's row is, for listings in other orders
+    int *row = ( int * ) statsMalloc( ( menu->count + 1 ) * sizeof( int ) );
+    for ( int i = 0; i < menu->count; i++ )
+        row[ menu->menuView[ i ] ] = i;
+    
+    statsFree( menu->idRow );
+    menu->idRow = ( int * ) statsMalloc( ( menu->count + 1 ) * sizeof( int ) );
+    for ( int i = 0; i < menu->count; i++ )
+        menu->idRow[ i ] = row[ menu->idView[ i ] ];
+    
+    // cost orders, kept as rows; the category one shares categoryStart's ranges
+    statsFree( menu->costRows );
+    statsFree( menu->categoryCostRows );
+    menu->costRows = ( int * ) statsMalloc( ( menu->count + 1 ) * sizeof( int ) );
+    menu->categoryCostRows = ( int * ) statsMalloc( ( menu->count + 1 ) * sizeof( int ) );
+    
+    // by cost, then id
+    for ( int i = 0; i < menu->count; i++ )
+        keys[ i ] = (unsigned long long) menu->items[ i ].cost << 32 |
+                    menuItemKey( menu->items[ i ].id );
+    sortView( menu->costRows, keys, menu->count );
+    
+    // by category, then cost, then id: a stable sort of the cost order by category
+    memcpy( menu->categoryCostRows, menu->costRows, menu->count * sizeof( int ) );
+    for ( int i = 0; i < menu->count; i++ )
+        keys[ i ] = menu->items[ menu->categoryCostRows[ i ] ].categoryId;
+    radixSort( keys, menu->categoryCostRows, menu->count );
+    
+    statsFree( keys );
+    
+    for ( int i = 0; i < menu->count; i++ ) {
+        menu->costRows[ i ] = row[ menu->costRows[ i ] ];
+        menu->categoryCostRows[ i ] = row[ menu->categoryCostRows[ i ] ];
+    }
+    
+    statsFree( row );
+        
+    renderRows( menu );
+    indexMenuNames( menu );
+}
+
+/**
+    Finds the menuView positions of the whole menu or one category.
+    
+    @param *menu Menu to search
+    @param *category category to find, or NULL for the whole menu
+    @param *start where to store the first position
+    @param *end where to store the position after the last one ( same as *start
+                if there's no such category )
+  */
+static void categoryRange( struct Menu const *menu, char const *category, int *start,
+                           int *end ) {
+
+    *start = 0;
+    *end = menu->count;
+    
+    if ( category ) {
+        int id = findCategory( menu, category );
+        *start = id < 0 ? 0 : menu->categoryStart[ id ];
+        *end = id < 0 ? 0 : menu->categoryStart[ id + 1 ];
+    }
+}
+
+/**
+    Prints the pre-rendered rows for a range of menuView positions.
+    
+    @param *menu Menu the rows belong to
+    @param start first position to print
+    @param end position after the last one to print
+    @param *out stream to print to
+  */
+static void printRowRange( struct Menu const *menu, int start, int end, FILE *out ) {
+
+    fwrite( menu->rows + menu->rowStart[ start ], 1,
+            menu->rowStart[ end ] - menu->rowStart[ start ], out );
+}
+
+/**
+    Prints the MenuItems in the given Menu, either the whole menu ( sorted by
+    category, then id ) or just one category ( sorted by id ).
+    
+    @param *menu Menu to print
+    @param *category category to print, or NULL for the whole menu
+    @param *out stream to print to
+  */
+void listMenuItems( struct Menu const *menu, char const *category, FILE *out ) {
+
+    long long timer = statsStart();
+    int start, end;
+    
+    if ( !category )
+        fputs( "list menu\n" MENU_HEADER, out );
+    else
+        fprintf( out, "list category %s\n" MENU_HEADER, category );
+    
+    categoryRange( menu, category, &start, &end );
+    printRowRange( menu, start, end, out );
+            
+    putc( '\n', out );
+    statsStop( STATS_LIST_MENU_ITEMS, timer );
+}
+
+/**
+    Prints one page of the whole menu ( sorted by category, then id ) or of
+    one category ( sorted by id ), under the listing header. Pages are cut
+    straight from the sorted view, so a page costs the same however big the
+    menu is.
+    
+    @param *menu Menu to print
+    @param *category category to print, or NULL for the whole menu
+    @param page page to print ( from 1 ); pages past the end print no MenuItems
+    @param size number of MenuItems on a page
+    @param *out stream to print to
+  */
+void listMenuPage( struct Menu const *menu, char const *category, int page, int size, FILE *out ) {
+
+    long long timer = statsStart();
+    int start, end;
+    
+    categoryRange( menu, category, &start, &end );
+    
+    // 64-bit so a huge page number or size can't wrap around
+    long long first = start + ( long long ) ( page - 1 ) * size;
+    if ( first < end ) {
+        start = first;
+        if ( end - start > size )
+            end = start + size;
+    } else {
+        start = end;
+    }
+    
+    fputs( MENU_HEADER, out );
+    printRowRange( menu, start, end, out );
+    putc( '\n', out );
+    statsStop( STATS_LIST_MENU_ITEMS, timer );
+}
+
+/**
+    Prints the rows at the given positions of a row list.
+    
+    @param *menu Menu the rows belong to
+    @param *rows row list
+    @param start first position to print
+    @param end position after the last one to print
+    @param *out stream to print to
+  */
+static void printRows( struct Menu const *menu, int const *rows, int start, int end,
+                       FILE *out ) {
+
+    for ( int i = start; i < end; i++ ) {
+        int row = rows[ i ];
+        fwrite( menu->rows + menu->rowStart[ row ], 1,
+                menu->rowStart[ row + 1 ] - menu->rowStart[ row ], out );
+    }
+}
+
+/**
+    Finds the first position in a cost-ordered range of rows whose MenuItem
+    costs at least the given amount.
+    
+    @param *menu Menu the rows belong to
+    @param *rows row list, sorted by cost within the range
+    @param lo first position of the range
+    @param hi position after the last one in the range
+    @param cost cost to look for, in cents
+    @return the position ( hi if every MenuItem in the range is cheaper )
+  */
+static int costLowerBound( struct Menu const *menu, int const *rows, int lo, int hi,
+                           long long cost ) {
+
+    while ( lo < hi ) {
+        int mid = ( lo + hi ) / 2;
+        if ( menu->items[ menu->menuView[ rows[ mid ] ] ].cost < cost )
+            lo = mid + 1;
+        else
+            hi = mid;
     }
     
-    printf( "\n" );
+    return lo;
+}
+
+/**
+    Prints the MenuItems that cost from min to max, cheapest first ( then
+    by id ), under the listing header.
+    
+    @param *menu Menu to print
+    @param min lowest cost to print, in cents
+    @param max highest cost to print, in cents
+    @param *out stream to print to
+  */
+void listPriceRange( struct Menu const *menu, long long min, long long max, FILE *out ) {
+
+    long long timer = statsStart();
+    int start = costLowerBound( menu, menu->costRows, 0, menu->count, min );
+    int end = costLowerBound( menu, menu->costRows, start, menu->count, max + 1 );
+    
+    fputs( MENU_HEADER, out );
+    printRows( menu, menu->costRows, start, end, out );
+    putc( '\n', out );
+    statsStop( STATS_LIST_PRICE_RANGE, timer );
+}
+
+/**
+    Prints the cheapest MenuItems ( then by id ), from the whole menu or one
+    category, under the listing header.
+    
+    @param *menu Menu to print
+    @param count how many MenuItems to print at most
+    @param *category category to print from, or NULL for the whole menu
+    @param *out stream to print to
+  */
+void listCheapest( struct Menu const *menu, int count, char const *category, FILE *out ) {
+
+    long long timer = statsStart();
+    int const *rows = menu->costRows;
+    int start = 0;
+    int end = menu->count;
+    
+    if ( category ) {
+        int id = findCategory( menu, category );
+        rows = menu->categoryCostRows;
+        start = id < 0 ? 0 : menu->categoryStart[ id ];
+        end = id < 0 ? 0 : menu->categoryStart[ id + 1 ];
+    }
+    
+    if ( end - start > count )
+        end = start + count;
+    
+    fputs( MENU_HEADER, out );
+    printRows( menu, rows, start, end, out );
+    putc( '\n', out );
+    statsStop( STATS_LIST_CHEAPEST_ITEMS, timer );
 }
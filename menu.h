@@ -12,6 +12,32 @@
 /** initial number of Menu array elements */
 #define MENU_INITIAL_CAPACITY 5
 
+/** initial number of slots in the Menu id index ( must be a power of 2 ) */
+#define MENU_INDEX_INITIAL_SIZE 16
+
+/** initial number of slots in the Menu category index ( must be a power of 2 ) */
+#define CATEGORY_INDEX_INITIAL_SIZE 16
+
+/** most threads used to parse menu files in parallel */
+#define MENU_MAX_PARSE_THREADS 16
+
+/** readMenuItems() status: the file was read */
+#define MENU_OK 0
+
+/** readMenuItems() status: the file couldn't be opened */
+#define MENU_CANT_OPEN 1
+
+/** readMenuItems() status: the file has an invalid line or a repeated id */
+#define MENU_INVALID 2
+
+/** results of parseMenuLine(): the line is valid, or the first rule it breaks */
+#define LINE_OK 0
+#define LINE_BLANK 1
+#define LINE_BAD_ID 2
+#define LINE_BAD_CATEGORY 3
+#define LINE_BAD_COST 4
+#define LINE_BAD_NAME 5
+
 /** number of characters for a MenuItem id number ( 4 ) ( +1 for null terminator ) */
 #define NUM_CHAR_ID 5
 
@@ -21,16 +47,61 @@
 /** maximum number of characters for a MenuItem category ( 15 ) ( +1 for null terminator ) */
 #define MAX_NUM_CHAR_CATEGORY 16
 
+/** header row printed before MenuItem listings */
+#define MENU_HEADER "ID   Name                 Category        Cost\n"
+
+/** number of MenuItems on a page of a listing when no page size is given */
+#define MENU_PAGE_SIZE 10
+
+/** length of a MenuItem listing row ( "%-5s%-21s%-16s$%6.2f\n" ) */
+#define MENU_ROW_LENGTH 50
+
+/** longest a MenuItem listing row can be ( a cost of INT_MAX cents ) */
+#define MENU_MAX_ROW_LENGTH 64
+
 /** number of cents in a dollar */
 #define CENTS_IN_A_DOLLAR 100.0
 
+/** number of cents in a dollar ( for whole-cent arithmetic ) */
+#define CENTS_PER_DOLLAR 100
+
 /**
-    A menu.
+    A menu. MenuItems are stored contiguously and only move while files are
+    still being read, so pointers to them stay valid once loading is done.
+
+    The id and category indexes are open-addressed tables whose slots hold
+    an index + 1 ( 0 if empty ), sized to a power of 2. The start arrays
+    ( categoryStart, rowStart and gramStart ) have one more entry than the
+    things they start, so entry i + 1 is where entry i ends. The views,
+    row arrays, trigram tables and postings either point into a mapped
+    snapshot file or are allocated, when snapshot is NULL.
   */
 struct Menu {
-    struct MenuItem **list; // list of menu items
+    struct MenuItem *items; // contiguous storage for the menu items
     int count;              // number of menu items
-    int capacity;           // capacity of the list
+    int capacity;           // capacity of the item storage
+    int *menuView;          // item indexes sorted by category, then id
+    int *idView;            // item indexes sorted by id
+    int *index;             // table of item indexes by id
+    int indexSize;          // number of slots in the index
+    char ( *categories )[ MAX_NUM_CHAR_CATEGORY ]; // interned category names, sorted
+    int categoryCount;      // number of distinct categories
+    int categoryCapacity;   // capacity of the category list
+    int *categoryIndex;     // table of category ids by name
+    int categoryIndexSize;  // number of slots in the category index
+    int *categoryStart;     // where each category's items start in menuView
+    char *rows;             // every item's listing row, formatted once, in menuView order
+    int *rowStart;          // where the row for each menuView position starts
+    int *idRow;             // menuView position of the item at each idView position
+    int *costRows;          // menuView positions sorted by cost, then id
+    int *categoryCostRows;  // menuView positions sorted by category, cost, then id
+    unsigned int *gramKeys; // every trigram of the lowercased names, sorted ( see search.h )
+    int gramCount;          // number of trigrams
+    int *gramStart;         // where each trigram's list starts in postings
+    int *postings;          // idView positions of the items whose names contain each trigram
+    void *snapshot;         // mapped snapshot file the arrays point into
+    size_t snapshotSize;    // number of bytes mapped for the snapshot
+    int references;         // sessions and sources using the Menu ( see reload.c )
 };
 
 /**
@@ -40,6 +111,7 @@ struct MenuItem {
     char id[ NUM_CHAR_ID ];                 // id number of the menu item ( stored as a string )
     char name[ MAX_NUM_CHAR_NAME ];         // name of the menu item
     char category[ MAX_NUM_CHAR_CATEGORY ]; // category of the menu item
+    int categoryId;                         // interned category ( index into Menu categories )
     int cost;                               // cost of the menu item
 };
 
@@ -58,20 +130,134 @@ struct Menu *makeMenu();
 void freeMenu( struct Menu *menu );
 
 /**
-    Reads all MenuItems from a file with the given name.
+    Packs a MenuItem id into an integer. Keys compare in the same order as the
+    ids do with strcmp().
+    
+    @param *id id to pack ( NUM_CHAR_ID - 1 characters )
+    @return the packed id
+  */
+unsigned int menuItemKey( char const *id );
+
+/**
+    Scrambles a packed id so that ids differing only in a few characters
+    spread across a whole hash table.
+    
+    @param key packed id ( from menuItemKey() )
+    @return hash of the key
+  */
+unsigned int hashMenuItemKey( unsigned int key );
+
+/**
+    Finds the MenuItem with the given id in constant time.
+    
+    @param *menu Menu to search
+    @param *id id to look for
+    @return the MenuItem, or NULL if the Menu doesn't have one with that id
+  */
+struct MenuItem *findMenuItem( struct Menu const *menu, char const *id );
+
+/**
+    Finds the interned id of the category with the given name.
+    
+    @param *menu Menu to search
+    @param *name category name
+    @return the category id, or -1 if no MenuItem has that category
+  */
+int findCategory( struct Menu const *menu, char const *name );
+
+/**
+    Parses one line of a menu file into the given MenuItem. Fields are read
+    straight from the line's bytes, which do not need to be null terminated.
+    
+    @param *p first character of the line
+    @param *end one past the last character of the line ( not including the newline )
+    @param *item MenuItem to fill in
+    @return LINE_OK if the line is a valid menu item, or the LINE_ code of the
+            first rule it breaks
+  */
+int parseMenuLine( char const *p, char const *end, struct MenuItem *item );
+
+/**
+    Reads all MenuItems from a file with the given name. Regular files are
+    memory-mapped and parsed in place.
     
     @param *filename name of file to read from
     @param *menu Menu to add to
+    @return MENU_OK, MENU_CANT_OPEN if the file can't be opened, or MENU_INVALID
+            if a line is invalid or repeats the id of an earlier MenuItem
+  */
+int readMenuItems( char const *filename, struct Menu *menu );
+
+/**
+    Reads all MenuItems from the files with the given names. The files are
+    parsed in parallel, then merged in the order given, so the result ( and
+    the file blamed for any error ) is the same as reading them one by one
+    with readMenuItems().
+    
+    A mapped file that shrinks while it is parsed kills the process with
+    SIGBUS, so files that may be rewritten underneath us ( a reload after a
+    change ) should be read instead.
+    
+    @param *filenames names of files to read from
+    @param count number of files
+    @param *menu Menu to add to
+    @param *bad set to the index of the file that caused an error, if any
+    @param map false to read the files instead of memory-mapping them
+    @return MENU_OK, or the readMenuItems() status of the file that caused an error
+  */
+int readMenuFiles( char *const *filenames, int count, struct Menu *menu, int *bad, bool map );
+
+/**
+    Builds the sorted views, the pre-rendered listing rows and the name index
+    of the Menu. Call once all files have been read; listings reuse them
+    instead of sorting and formatting again.
+    
+    @param *menu Menu to sort
+  */
+void sortMenuItems( struct Menu *menu );
+
+/**
+    Prints the MenuItems in the given Menu, either the whole menu ( sorted by
+    category, then id ) or just one category ( sorted by id ).
+    
+    @param *menu Menu to print
+    @param *category category to print, or NULL for the whole menu
+    @param *out stream to print to
+  */
+void listMenuItems( struct Menu const *menu, char const *category, FILE *out );
+
+/**
+    Prints one page of the whole menu ( sorted by category, then id ) or of
+    one category ( sorted by id ), under the listing header. Pages are cut
+    straight from the sorted view, so a page costs the same however big the
+    menu is.
+    
+    @param *menu Menu to print
+    @param *category category to print, or NULL for the whole menu
+    @param page page to print ( from 1 ); pages past the end print no MenuItems
+    @param size number of MenuItems on a page
+    @param *out stream to print to
+  */
+void listMenuPage( struct Menu const *menu, char const *category, int page, int size, FILE *out );
+
+/**
+    Prints the MenuItems that cost from min to max, cheapest first ( then
+    by id ), under the listing header.
+    
+    @param *menu Menu to print
+    @param min lowest cost to print, in cents
+    @param max highest cost to print, in cents
+    @param *out stream to print to
   */
-void readMenuItems( char const *filename, struct Menu *menu );
+void listPriceRange( struct Menu const *menu, long long min, long long max, FILE *out );
 
 /**
-    Sorts the MenuItems in the given Menu and then prints them.
+    Prints the cheapest MenuItems ( then by id ), from the whole menu or one
+    category, under the listing header.
     
     @param *menu Menu to print
-    @param *compare pointer to a function that will be passed to qsort()
-    @param *test pointer to a function that will filter based on category
-    @param *str pointer to standard input string
+    @param count how many MenuItems to print at most
+    @param *category category to print from, or NULL for the whole menu
+    @param *out stream to print to
   */
-void listMenuItems( struct Menu *menu, int (*compare)( void const *va, void const *vb ), 
-bool (*test)( struct MenuItem const *item, char const *str ), char const *str );
+void listCheapest( struct Menu const *menu, int count, char const *category, FILE *out );
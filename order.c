@@ -0,0 +1,575 @@
+/**
+    @filename order.c
+    @author Will Greene (wgreene)
+
+    Creates an Order, keeps its OrderItems in listing order, prints them, and
+    frees memory.
+  */
+#include "order.h"
+#include "menu.h"
+#include "stats.h"
+#include "pool.h"
+#include "sort.h"
+
+#include <limits.h>
+
+/**
+    Initializes the fields of an empty Order.
+
+    @param *order Order to initialize
+    @param *pool Pool to allocate its OrderItems from
+  */
+static void initOrder( struct Order *order, struct Pool *pool ) {
+
+    order->list = ( struct OrderItem ** ) statsMalloc( ORDER_INITIAL_CAPACITY *
+                  sizeof( struct OrderItem * ) );
+    order->count = 0;
+    order->capacity = ORDER_INITIAL_CAPACITY;
+    order->total = 0;
+
+    order->index = ( struct OrderItem ** ) statsCalloc( ORDER_INDEX_INITIAL_SIZE,
+                   sizeof( struct OrderItem * ) );
+    order->indexSize = ORDER_INDEX_INITIAL_SIZE;
+    order->pool = pool;
+    order->number = 0;
+    order->ticket = 0;
+}
+
+/**
+    Frees the memory an Order's list and index use. The OrderItems are left
+    to whoever owns their pool.
+
+    @param *order Order to clear
+  */
+static void clearOrder( struct Order *order ) {
+
+    statsFree( order->list );
+    statsFree( order->index );
+}
+
+/**
+    Allocates storage for an Order, and initializes its fields.
+
+    @return the Order
+  */
+struct Order *makeOrder() {
+
+    struct Order *order = (struct Order *) statsMalloc( sizeof( struct Order ) );
+    initOrder( order, makePool( sizeof( struct OrderItem ) ) );
+    return order;
+}
+
+/**
+    Frees the memory used to store the given Order and its OrderItems. The
+    OrderItems all go at once with their pool, however many there are.
+
+    @param *order Order to be freed
+  */
+void freeOrder( struct Order *order ) {
+
+    freePool( order->pool );
+    clearOrder( order );
+    statsFree( order );
+}
+
+/**
+    Allocates storage for an empty OrderBook.
+
+    @return the OrderBook
+  */
+struct OrderBook *makeOrderBook() {
+
+    struct OrderBook *book = (struct OrderBook *) statsMalloc( sizeof( struct OrderBook ) );
+
+    book->orders = ( struct Order ** ) statsCalloc( ORDER_BOOK_INITIAL_CAPACITY,
+                   sizeof( struct Order * ) );
+    book->capacity = ORDER_BOOK_INITIAL_CAPACITY;
+    book->index = ( struct Order ** ) statsCalloc( ORDER_BOOK_INDEX_INITIAL_SIZE,
+                  sizeof( struct Order * ) );
+    book->indexSize = ORDER_BOOK_INDEX_INITIAL_SIZE;
+    book->next = 1;
+    book->current = 0;
+    book->open = 0;
+    book->pool = makePool( sizeof( struct Order ) );
+    book->itemPool = makePool( sizeof( struct OrderItem ) );
+
+    return book;
+}
+
+/**
+    Frees the memory used to store the given OrderBook and every Order still
+    open in it.
+
+    @param *book OrderBook to be freed
+  */
+void freeOrderBook( struct OrderBook *book ) {
+
+    // the OrderItems all go at once with their pool
+    for ( int i = 0; i < book->open; i++ )
+        clearOrder( book->orders[ i ] );
+
+    freePool( book->itemPool );
+    freePool( book->pool );
+    statsFree( book->orders );
+    statsFree( book->index );
+    statsFree( book );
+}
+
+/**
+    Finds the index slot that holds the open Order with the given number, or
+    the empty slot where it would go.
+
+    @param *book OrderBook to search
+    @param number number of the Order
+    @return the slot
+  */
+static struct Order **findOrderSlot( struct OrderBook const *book, int number ) {
+
+    // numbers are handed out in sequence, so they spread over the slots by themselves
+    unsigned int mask = book->indexSize - 1;
+    unsigned int i = ( unsigned int ) number & mask;
+
+    // linear probing
+    while ( book->index[ i ] && book->index[ i ]->number != number )
+        i = ( i + 1 ) & mask;
+
+    return &book->index[ i ];
+}
+
+/**
+    Doubles the size of the OrderBook's index, rehashing every open Order
+    into it.
+
+    @param *book OrderBook whose index should grow
+  */
+static void growOrderIndex( struct OrderBook *book ) {
+
+    statsFree( book->index );
+    book->indexSize *= 2;
+    book->index = ( struct Order ** ) statsCalloc( book->indexSize, sizeof( struct Order * ) );
+
+    for ( int i = 0; i < book->open; i++ )
+        *findOrderSlot( book, book->orders[ i ]->number ) = book->orders[ i ];
+}
+
+/**
+    Removes an Order from the OrderBook's index, shifting later entries of
+    its probe run back so lookups never stop early.
+
+    @param *book OrderBook to remove from
+    @param number number of the Order to remove
+  */
+static void unindexOrder( struct OrderBook *book, int number ) {
+
+    unsigned int mask = book->indexSize - 1;
+    unsigned int hole = findOrderSlot( book, number ) - book->index;
+    book->index[ hole ] = NULL;
+
+    for ( unsigned int i = ( hole + 1 ) & mask; book->index[ i ]; i = ( i + 1 ) & mask ) {
+
+        unsigned int home = ( unsigned int ) book->index[ i ]->number & mask;
+
+        // move the entry into the hole unless its home lies between the hole and it
+        if ( ( ( i - home ) & mask ) >= ( ( i - hole ) & mask ) ) {
+            book->index[ hole ] = book->index[ i ];
+            book->index[ i ] = NULL;
+            hole = i;
+        }
+    }
+}
+
+/**
+    Opens a new, empty Order with the given number, and makes it the current
+    one. Numbers are never reused: the number must not be open already, and
+    is normally book->next ( a replayed journal may open older ones ).
+
+    @param *book OrderBook to open the Order in
+    @param number number of the new Order
+    @return the Order
+  */
+struct Order *openOrder( struct OrderBook *book, int number ) {
+
+    // capacity check ( double if at or above capacity )
+    if ( book->open >= book->capacity ) {
+        book->capacity *= 2;
+        book->orders = statsRealloc( book->orders, sizeof( struct Order * ) * book->capacity );
+    }
+
+    struct Order *order = (struct Order *) poolAlloc( book->pool );
+    initOrder( order, book->itemPool );
+    order->number = number;
+    order->position = book->open;
+
+    book->orders[ book->open++ ] = order;
+    *findOrderSlot( book, number ) = order;
+
+    // keep the index at most half full
+    if ( book->open * 2 > book->indexSize )
+        growOrderIndex( book );
+
+    if ( number >= book->next )
+        book->next = number + 1;
+    book->current = number;
+
+    return order;
+}
+
+/**
+    Finds the open Order with the given number in constant time.
+
+    @param *book OrderBook to search
+    @param number number of the Order
+    @return the Order, or NULL if no open Order has that number
+  */
+struct Order *findOrder( struct OrderBook const *book, int number ) {
+
+    return *findOrderSlot( book, number );
+}
+
+/**
+    Closes the open Order with the given number, freeing it and giving its
+    OrderItems back to the OrderBook's pool. If it was the current Order, no
+    Order is current afterwards. The last Order in the list takes its place.
+
+    @param *book OrderBook to close the Order in
+    @param number number of an open Order
+  */
+void closeOrder( struct OrderBook *book, int number ) {
+
+    struct Order *order = *findOrderSlot( book, number );
+    unindexOrder( book, number );
+
+    struct Order *last = book->orders[ --book->open ];
+    book->orders[ order->position ] = last;
+    last->position = order->position;
+
+    for ( int i = 0; i < order->count; i++ )
+        poolFree( book->itemPool, order->list[ i ] );
+    clearOrder( order );
+    poolFree( book->pool, order );
+
+    if ( book->current == number )
+        book->current = 0;
+}
+
+/**
+    Compares 2 OrderItems to determine order ( based on cost * quantity,
+    then id ).
+
+    @param *a first OrderItem
+    @param *b second OrderItem
+    @return a negative number if *a comes before *b,
+            a positive number if *b comes before *a,
+            and 0 if the items are identical
+  */
+static int listOrderComp( struct OrderItem const *a, struct OrderItem const *b ) {
+
+    long long costA = (long long) a->menuItem->cost * a->quantity;
+    long long costB = (long long) b->menuItem->cost * b->quantity;
+
+    if ( costA > costB )
+        return -1;
+
+    if ( costA < costB )
+        return 1;
+
+    // packed ids compare like strcmp() on the ids
+    unsigned int idA = menuItemKey( a->menuItem->id );
+    unsigned int idB = menuItemKey( b->menuItem->id );
+    return ( idA > idB ) - ( idA < idB );
+}
+
+/**
+    Finds the index slot that holds the OrderItem with the given id, or the
+    empty slot where it would go.
+
+    @param *order Order to search
+    @param key packed id of the MenuItem ( from menuItemKey() )
+    @return the slot
+  */
+static struct OrderItem **findSlot( struct Order const *order, unsigned int key ) {
+
+    unsigned int mask = order->indexSize - 1;
+    unsigned int i = hashMenuItemKey( key ) & mask;
+
+    // linear probing
+    while ( order->index[ i ] && menuItemKey( order->index[ i ]->menuItem->id ) != key )
+        i = ( i + 1 ) & mask;
+
+    return &order->index[ i ];
+}
+
+/**
+    Finds the OrderItem for the MenuItem with the given id.
+
+    @param *order Order to search
+    @param *id id of the MenuItem to look for
+    @return the OrderItem, or NULL if no MenuItem with that id is in the Order
+  */
+struct OrderItem *findOrderItem( struct Order const *order, char const *id ) {
+
+    if ( strlen( id ) != NUM_CHAR_ID - 1 )
+        return NULL;
+
+    return *findSlot( order, menuItemKey( id ) );
+}
+
+/**
+    Doubles the size of the id index, rehashing every OrderItem into it.
+
+    @param *order Order whose index should grow
+  */
+static void growIndex( struct Order *order ) {
+
+    struct OrderItem **old = order->index;
+    int oldSize = order->indexSize;
+
+    order->indexSize *= 2;
+    order->index = ( struct OrderItem ** ) statsCalloc( order->indexSize,
+                   sizeof( struct OrderItem * ) );
+
+    for ( int i = 0; i < oldSize; i++ ) {
+        if ( old[ i ] )
+            *findSlot( order, menuItemKey( old[ i ]->menuItem->id ) ) = old[ i ];
+    }
+
+    statsFree( old );
+}
+
+/**
+    Removes an OrderItem from the id index, shifting later entries of its
+    probe run back so lookups never stop early.
+
+    @param *order Order to remove from
+    @param *orderItem OrderItem to remove
+  */
+static void unindex( struct Order *order, struct OrderItem const *orderItem ) {
+
+    unsigned int mask = order->indexSize - 1;
+    unsigned int hole = findSlot( order, menuItemKey( orderItem->menuItem->id ) ) - order->index;
+    order->index[ hole ] = NULL;
+
+    for ( unsigned int i = ( hole + 1 ) & mask; order->index[ i ]; i = ( i + 1 ) & mask ) {
+
+        unsigned int key = menuItemKey( order->index[ i ]->menuItem->id );
+        unsigned int home = hashMenuItemKey( key ) & mask;
+
+        // move the entry into the hole unless its home lies between the hole and it
+        if ( ( ( i - home ) & mask ) >= ( ( i - hole ) & mask ) ) {
+            order->index[ hole ] = order->index[ i ];
+            order->index[ i ] = NULL;
+            hole = i;
+        }
+    }
+}
+
+/**
+    Finds where an OrderItem currently sits in the list. Must be called while
+    its quantity is still the one it was sorted by.
+
+    @param *order Order to search
+    @param *orderItem OrderItem to look for
+    @return its position in the list
+  */
+static int findPosition( struct Order const *order, struct OrderItem const *orderItem ) {
+
+    int lo = 0;
+    int hi = order->count;
+
+    while ( lo < hi ) {
+        int mid = ( lo + hi ) / 2;
+        int c = listOrderComp( order->list[ mid ], orderItem );
+        if ( c == 0 )
+            return mid;
+        if ( c < 0 )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/**
+    Moves the OrderItem at the given position to where it belongs after its
+    quantity has changed, shifting only the items in between.
+
+    @param *order Order to update
+    @param pos current position of the OrderItem
+  */
+static void reposition( struct Order *order, int pos ) {
+
+    struct OrderItem **list = order->list;
+    struct OrderItem *orderItem = list[ pos ];
+
+    if ( pos > 0 && listOrderComp( orderItem, list[ pos - 1 ] ) < 0 ) {
+
+        // earlier: first position in [ 0, pos ) that sorts after it
+        int lo = 0;
+        int hi = pos;
+        while ( lo < hi ) {
+            int mid = ( lo + hi ) / 2;
+            if ( listOrderComp( list[ mid ], orderItem ) > 0 )
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+
+        memmove( list + lo + 1, list + lo, ( pos - lo ) * sizeof( struct OrderItem * ) );
+        list[ lo ] = orderItem;
+
+    } else if ( pos < order->count - 1 && listOrderComp( orderItem, list[ pos + 1 ] ) > 0 ) {
+
+        // later: just before the first position in ( pos, count ) that sorts after it
+        int lo = pos + 1;
+        int hi = order->count;
+        while ( lo < hi ) {
+            int mid = ( lo + hi ) / 2;
+            if ( listOrderComp( list[ mid ], orderItem ) > 0 )
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+
+        memmove( list + pos, list + pos + 1, ( lo - 1 - pos ) * sizeof( struct OrderItem * ) );
+        list[ lo - 1 ] = orderItem;
+    }
+}
+
+/**
+    Adds some of a MenuItem to the Order, creating its OrderItem if needed.
+
+    @param *order Order to add to
+    @param *item MenuItem to add
+    @param quantity how many to add
+  */
+void addOrderItem( struct Order *order, struct MenuItem *item, int quantity ) {
+
+    struct OrderItem **slot = findSlot( order, menuItemKey( item->id ) );
+    int pos;
+
+    if ( *slot ) {
+        pos = findPosition( order, *slot );
+        ( *slot )->quantity += quantity;
+    } else {
+
+        // capacity check ( double if at or above capacity )
+        if ( order->count >= order->capacity ) {
+            order->capacity *= 2;
+            order->list = statsRealloc( order->list,
+                                        sizeof( struct OrderItem * ) * order->capacity );
+        }
+
+        struct OrderItem *orderItem = (struct OrderItem *) poolAlloc( order->pool );
+        orderItem->menuItem = item;
+        orderItem->quantity = quantity;
+
+        *slot = orderItem;
+        pos = order->count;
+        order->list[ order->count ] = orderItem;
+        (order->count)++;
+
+        // keep the index at most half full
+        if ( order->count * 2 > order->indexSize )
+            growIndex( order );
+    }
+
+    order->total += (long long) item->cost * quantity;
+    reposition( order, pos );
+}
+
+/**
+    Takes some of an OrderItem out of the Order, removing the OrderItem
+    entirely once its quantity reaches zero.
+
+    @param *order Order to remove from
+    @param *orderItem OrderItem to remove from
+    @param quantity how many to remove
+  */
+void removeOrderItem( struct Order *order, struct OrderItem *orderItem, int quantity ) {
+
+    int pos = findPosition( order, orderItem );
+
+    order->total -= (long long) orderItem->menuItem->cost * quantity;
+    orderItem->quantity -= quantity;
+
+    if ( orderItem->quantity != 0 ) {
+        reposition( order, pos );
+        return;
+    }
+
+    unindex( order, orderItem );
+    memmove( order->list + pos, order->list + pos + 1,
+             ( order->count - pos - 1 ) * sizeof( struct OrderItem * ) );
+    (order->count)--;
+
+    poolFree( order->pool, orderItem );
+}
+
+/**
+    Re-sorts the list and recomputes the total after the OrderItems' MenuItems
+    have been replaced ( for example by a reloaded menu with new prices ).
+
+    @param *order Order to update
+  */
+void repriceOrder( struct Order *order ) {
+
+    int n = order->count;
+    unsigned long long *keys = ( unsigned long long * ) statsMalloc( ( n + 1 ) *
+                               sizeof( unsigned long long ) );
+    int *positions = ( int * ) statsMalloc( ( n + 1 ) * sizeof( int ) );
+
+    // by id, then ( stably ) by cost * quantity, largest first, as listOrderComp() orders them
+    for ( int i = 0; i < n; i++ ) {
+        positions[ i ] = i;
+        keys[ i ] = menuItemKey( order->list[ i ]->menuItem->id );
+    }
+    radixSort( keys, positions, n );
+
+    for ( int i = 0; i < n; i++ ) {
+        struct OrderItem const *orderItem = order->list[ positions[ i ] ];
+        keys[ i ] = LLONG_MAX - (long long) orderItem->menuItem->cost * orderItem->quantity;
+    }
+    radixSort( keys, positions, n );
+
+    struct OrderItem **sorted = ( struct OrderItem ** ) statsMalloc( order->capacity *
+                                sizeof( struct OrderItem * ) );
+    for ( int i = 0; i < n; i++ )
+        sorted[ i ] = order->list[ positions[ i ] ];
+
+    statsFree( order->list );
+    order->list = sorted;
+    statsFree( positions );
+    statsFree( keys );
+
+    order->total = 0;
+    for ( int i = 0; i < order->count; i++ )
+        order->total += (long long) order->list[ i ]->menuItem->cost * order->list[ i ]->quantity;
+}
+
+/**
+    Prints the OrderItems in the given Order, followed by the total.
+
+    @param *order Order to print
+    @param *out stream to print to
+  */
+void listOrderItems( struct Order const *order, FILE *out ) {
+
+    long long start = statsStart();
+
+    fprintf( out, "ID   Name                 Quantity Category        Cost\n" );
+
+    for ( int i = 0; i < order->count; i++ ) {
+
+        struct OrderItem const *orderItem = order->list[ i ];
+        long long cost = (long long) orderItem->menuItem->cost * orderItem->quantity;
+
+        fprintf( out, "%-5s%-21s%8d %-16s$%3lld.%02lld\n", orderItem->menuItem->id,
+                orderItem->menuItem->name, orderItem->quantity, orderItem->menuItem->category,
+                cost / CENTS_PER_DOLLAR, cost % CENTS_PER_DOLLAR );
+    }
+
+    fprintf( out, "Total                                              $%3lld.%02lld\n\n",
+            order->total / CENTS_PER_DOLLAR, order->total % CENTS_PER_DOLLAR );
+    statsStop( STATS_LIST_ORDER_ITEMS, start );
+}
@@ -0,0 +1,174 @@
+/**
+    @filename order.h
+    @author Will Greene (wgreene)
+
+    Header file for order.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+struct Pool;
+
+/** initial number of Order array elements */
+#define ORDER_INITIAL_CAPACITY 5
+
+/** initial number of slots in the Order id index ( must be a power of 2 ) */
+#define ORDER_INDEX_INITIAL_SIZE 16
+
+/** initial number of slots in an OrderBook's list of open Orders */
+#define ORDER_BOOK_INITIAL_CAPACITY 16
+
+/** initial number of slots in an OrderBook's index by number ( must be a power of 2 ) */
+#define ORDER_BOOK_INDEX_INITIAL_SIZE 32
+
+/**
+    An order item.
+  */
+struct OrderItem {
+    struct MenuItem *menuItem; // order item characteristics ( pointer to a MenuItem struct )
+    int quantity;              // quantity of this type of order item
+};
+
+/**
+    An order. The list is kept sorted the way it is printed ( cost * quantity
+    descending, then id ) as quantities change, and the total is kept in
+    whole cents.
+  */
+struct Order {
+    struct OrderItem **list;   // list of order items ( in listing order )
+    int count;                 // number of order items
+    int capacity;              // capacity of the list
+    long long total;           // total cost of the order in cents
+    struct OrderItem **index;  // open-addressed table of order items by id ( NULL if empty )
+    int indexSize;             // number of slots in the index ( a power of 2 )
+    struct Pool *pool;         // where the order items are allocated ( shared in an OrderBook )
+    int number;                // number of the Order in its OrderBook ( 0 if it isn't in one )
+    int position;              // where the Order is in its OrderBook's list
+    long long ticket;          // ticket it was checked out on, until that's written ( else 0 )
+};
+
+/**
+    The open Orders of a session, numbered from 1 in the order they were
+    opened. Only open Orders are kept, in a dense list, so a closed Order
+    takes no space; an open-addressed index finds one by number in constant
+    time, and closing one moves the last Order into its place. Orders come
+    from one pool, and all their OrderItems from another, so opening an
+    Order doesn't set up a pool of its own.
+  */
+struct OrderBook {
+    struct Order **orders; // open Orders ( in no particular order )
+    int capacity;          // number of slots in orders
+    struct Order **index;  // open-addressed table of open Orders by number ( NULL if empty )
+    int indexSize;         // number of slots in the index ( a power of 2 )
+    int next;              // number the next Order opened will get
+    int current;           // number of the Order commands apply to ( 0 if none is )
+    int open;              // number of open Orders ( in use in orders )
+    struct Pool *pool;     // where the Orders are allocated
+    struct Pool *itemPool; // where the Orders' OrderItems are allocated
+};
+
+/**
+    Allocates storage for an Order, and initializes its fields.
+
+    @return the Order
+  */
+struct Order *makeOrder();
+
+/**
+    Frees the memory used to store the given Order and its OrderItems. The
+    OrderItems all go at once with their pool, however many there are.
+
+    @param *order Order to be freed
+  */
+void freeOrder( struct Order *order );
+
+/**
+    Allocates storage for an empty OrderBook.
+
+    @return the OrderBook
+  */
+struct OrderBook *makeOrderBook();
+
+/**
+    Frees the memory used to store the given OrderBook and every Order still
+    open in it.
+
+    @param *book OrderBook to be freed
+  */
+void freeOrderBook( struct OrderBook *book );
+
+/**
+    Opens a new, empty Order with the given number, and makes it the current
+    one. Numbers are never reused: the number must not be open already, and
+    is normally book->next ( a replayed journal may open older ones ).
+
+    @param *book OrderBook to open the Order in
+    @param number number of the new Order
+    @return the Order
+  */
+struct Order *openOrder( struct OrderBook *book, int number );
+
+/**
+    Finds the open Order with the given number.
+
+    @param *book OrderBook to search
+    @param number number of the Order
+    @return the Order, or NULL if no open Order has that number
+  */
+struct Order *findOrder( struct OrderBook const *book, int number );
+
+/**
+    Closes the open Order with the given number, freeing it and giving its
+    OrderItems back to the OrderBook's pool. If it was the current Order, no
+    Order is current afterwards.
+
+    @param *book OrderBook to close the Order in
+    @param number number of an open Order
+  */
+void closeOrder( struct OrderBook *book, int number );
+
+/**
+    Finds the OrderItem for the MenuItem with the given id.
+
+    @param *order Order to search
+    @param *id id of the MenuItem to look for
+    @return the OrderItem, or NULL if no MenuItem with that id is in the Order
+  */
+struct OrderItem *findOrderItem( struct Order const *order, char const *id );
+
+/**
+    Adds some of a MenuItem to the Order, creating its OrderItem if needed.
+
+    @param *order Order to add to
+    @param *item MenuItem to add
+    @param quantity how many to add
+  */
+void addOrderItem( struct Order *order, struct MenuItem *item, int quantity );
+
+/**
+    Takes some of an OrderItem out of the Order, removing the OrderItem
+    entirely once its quantity reaches zero.
+
+    @param *order Order to remove from
+    @param *orderItem OrderItem to remove from
+    @param quantity how many to remove
+  */
+void removeOrderItem( struct Order *order, struct OrderItem *orderItem, int quantity );
+
+/**
+    Re-sorts the list and recomputes the total after the OrderItems' MenuItems
+    have been replaced ( for example by a reloaded menu with new prices ).
+
+    @param *order Order to update
+  */
+void repriceOrder( struct Order *order );
+
+/**
+    Prints the OrderItems in the given Order, followed by the total.
+
+    @param *order Order to print
+    @param *out stream to print to
+  */
+void listOrderItems( struct Order const *order, FILE *out );
@@ -0,0 +1,182 @@
+/**
+    @filename pool.c
+    @author Will Greene (wgreene)
+
+    Pools of same-sized objects, and scratch arenas for memory that only
+    lives as long as one command.
+  */
+#include "pool.h"
+#include "stats.h"
+
+/**
+    Header of an allocation that didn't fit in an Arena's block. The union
+    keeps the memory after it aligned.
+  */
+union Spill {
+    union Spill *next;                 // next spilled allocation
+    char align[ ARENA_ALIGN ];         // keeps the data after the header aligned
+};
+
+/**
+    Allocates storage for a Pool of objects of the given size.
+
+    @param objectSize size of each object
+    @return the Pool
+  */
+struct Pool *makePool( size_t objectSize ) {
+
+    struct Pool *pool = (struct Pool *) statsMalloc( sizeof( struct Pool ) );
+
+    // every object must be able to hold the free list link, and stay aligned
+    size_t link = sizeof( void * );
+    pool->objectSize = ( objectSize + link - 1 ) / link * link;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->freeList = NULL;
+    pool->chunks = NULL;
+    pool->chunkCount = 0;
+    pool->nextObjects = POOL_INITIAL_OBJECTS;
+
+    return pool;
+}
+
+/**
+    Frees the Pool and every object allocated from it.
+
+    @param *pool Pool to be freed
+  */
+void freePool( struct Pool *pool ) {
+
+    // chunks double in size, so there are only a few of them
+    for ( int i = 0; i < pool->chunkCount; i++ )
+        statsFree( pool->chunks[ i ] );
+
+    statsFree( pool->chunks );
+    statsFree( pool );
+}
+
+/**
+    Allocates an object from the Pool.
+
+    @param *pool Pool to allocate from
+    @return the object ( uninitialized )
+  */
+void *poolAlloc( struct Pool *pool ) {
+
+    if ( pool->freeList ) {
+        void *object = pool->freeList;
+        pool->freeList = *(void **) object;
+        return object;
+    }
+
+    if ( pool->next == pool->end ) {
+
+        size_t bytes = pool->nextObjects * pool->objectSize;
+        pool->chunks = statsRealloc( pool->chunks, ( pool->chunkCount + 1 ) * sizeof( void * ) );
+        pool->chunks[ pool->chunkCount ] = statsMalloc( bytes );
+        pool->next = pool->chunks[ pool->chunkCount++ ];
+        pool->end = pool->next + bytes;
+        pool->nextObjects *= 2;
+    }
+
+    void *object = pool->next;
+    pool->next += pool->objectSize;
+    return object;
+}
+
+/**
+    Gives an object back to the Pool for reuse.
+
+    @param *pool Pool the object came from
+    @param *object object to free
+  */
+void poolFree( struct Pool *pool, void *object ) {
+
+    *(void **) object = pool->freeList;
+    pool->freeList = object;
+}
+
+/**
+    Allocates storage for an empty Arena.
+
+    @return the Arena
+  */
+struct Arena *makeArena() {
+
+    struct Arena *arena = (struct Arena *) statsMalloc( sizeof( struct Arena ) );
+
+    arena->block = (char *) statsMalloc( ARENA_INITIAL_SIZE );
+    arena->capacity = ARENA_INITIAL_SIZE;
+    arena->used = 0;
+    arena->spills = NULL;
+    arena->spilled = 0;
+
+    return arena;
+}
+
+/**
+    Frees the Arena and everything allocated from it.
+
+    @param *arena Arena to be freed
+  */
+void freeArena( struct Arena *arena ) {
+
+    resetArena( arena );
+    statsFree( arena->block );
+    statsFree( arena );
+}
+
+/**
+    Allocates memory from the Arena, valid until the next reset.
+
+    @param *arena Arena to allocate from
+    @param size number of bytes
+    @return the memory ( aligned to ARENA_ALIGN, uninitialized )
+  */
+void *arenaAlloc( struct Arena *arena, size_t size ) {
+
+    size = ( size + ARENA_ALIGN - 1 ) / ARENA_ALIGN * ARENA_ALIGN;
+
+    if ( size <= arena->capacity - arena->used ) {
+        void *memory = arena->block + arena->used;
+        arena->used += size;
+        return memory;
+    }
+
+    // the block can't move while its memory is in use, so spill until the next reset
+    union Spill *spill = (union Spill *) statsMalloc( sizeof( union Spill ) + size );
+    spill->next = arena->spills;
+    arena->spills = spill;
+    arena->spilled += size;
+
+    return spill + 1;
+}
+
+/**
+    Releases everything allocated from the Arena since the last reset.
+
+    @param *arena Arena to reset
+  */
+void resetArena( struct Arena *arena ) {
+
+    if ( arena->spills ) {
+
+        for ( union Spill *spill = arena->spills; spill; ) {
+            union Spill *next = spill->next;
+            statsFree( spill );
+            spill = next;
+        }
+
+        // grow the block to hold everything that was needed this time
+        size_t needed = arena->used + arena->spilled;
+        while ( arena->capacity < needed )
+            arena->capacity *= 2;
+
+        statsFree( arena->block );
+        arena->block = (char *) statsMalloc( arena->capacity );
+        arena->spills = NULL;
+        arena->spilled = 0;
+    }
+
+    arena->used = 0;
+}
@@ -0,0 +1,110 @@
+/**
+    @filename pool.h
+    @author Will Greene (wgreene)
+
+    Header file for pool.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/** number of objects in the first chunk of a Pool ( later chunks double ) */
+#define POOL_INITIAL_OBJECTS 16
+
+/** initial number of bytes in an Arena's block */
+#define ARENA_INITIAL_SIZE 4096
+
+/** alignment of every Arena allocation */
+#define ARENA_ALIGN 16
+
+/**
+    A pool of same-sized objects. Objects are carved out of a few large
+    chunks, and freed objects are kept on a free list for reuse, so after
+    warm-up allocating and freeing never touch the heap. Freeing the Pool
+    frees every object in it at once.
+  */
+struct Pool {
+    size_t objectSize; // bytes per object ( at least a pointer, a multiple of pointer size )
+    char *next;        // next unused object in the newest chunk
+    char *end;         // end of the newest chunk
+    void *freeList;    // freed objects, linked through their first bytes
+    void **chunks;     // every chunk
+    int chunkCount;    // number of chunks
+    int nextObjects;   // number of objects in the next chunk
+};
+
+/**
+    A scratch arena for short-lived allocations. Allocation bumps a pointer,
+    and everything is released at once by resetting it. When a block
+    overflows, the extra requests are served by separate allocations until
+    the next reset, which replaces the block with one big enough for all of
+    them, so a steady workload stops allocating.
+  */
+struct Arena {
+    char *block;       // the current block
+    size_t capacity;   // size of the block
+    size_t used;       // bytes handed out from the block
+    void *spills;      // allocations that didn't fit, linked through a header
+    size_t spilled;    // bytes in the spilled allocations
+};
+
+/**
+    Allocates storage for a Pool of objects of the given size.
+
+    @param objectSize size of each object
+    @return the Pool
+  */
+struct Pool *makePool( size_t objectSize );
+
+/**
+    Frees the Pool and every object allocated from it.
+
+    @param *pool Pool to be freed
+  */
+void freePool( struct Pool *pool );
+
+/**
+    Allocates an object from the Pool.
+
+    @param *pool Pool to allocate from
+    @return the object ( uninitialized )
+  */
+void *poolAlloc( struct Pool *pool );
+
+/**
+    Gives an object back to the Pool for reuse.
+
+    @param *pool Pool the object came from
+    @param *object object to free
+  */
+void poolFree( struct Pool *pool, void *object );
+
+/**
+    Allocates storage for an empty Arena.
+
+    @return the Arena
+  */
+struct Arena *makeArena();
+
+/**
+    Frees the Arena and everything allocated from it.
+
+    @param *arena Arena to be freed
+  */
+void freeArena( struct Arena *arena );
+
+/**
+    Allocates memory from the Arena, valid until the next reset.
+
+    @param *arena Arena to allocate from
+    @param size number of bytes
+    @return the memory ( aligned to ARENA_ALIGN, uninitialized )
+  */
+void *arenaAlloc( struct Arena *arena, size_t size );
+
+/**
+    Releases everything allocated from the Arena since the last reset.
+
+    @param *arena Arena to reset
+  */
+void resetArena( struct Arena *arena );
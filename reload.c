@@ -0,0 +1,293 @@
+/**
+    @filename reload.c
+    @author Will Greene (wgreene)
+
+    Hands out the current Menu to sessions, and rebuilds and swaps it in the
+    background when the menu files change, without stopping any session.
+  */
+#include "menu.h"
+#include "snapshot.h"
+#include "reload.h"
+#include "stats.h"
+
+#include <libgen.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+    Allocates storage for a MenuSource that hands out the given Menu.
+
+    @param *menu Menu to start with ( owned by the source from now on )
+    @return the MenuSource
+  */
+struct MenuSource *makeMenuSource( struct Menu *menu ) {
+
+    struct MenuSource *source = (struct MenuSource *) statsMalloc( sizeof( struct MenuSource ) );
+
+    source->current = menu;
+    source->current->references = 1;
+    source->generation = 0;
+    pthread_mutex_init( &source->lock, NULL );
+    source->filenames = NULL;
+    source->fileCount = 0;
+    source->snapshot = false;
+    source->watching = false;
+
+    return source;
+}
+
+/**
+    Stops the watcher thread, if any, and frees the MenuSource and its
+    current Menu. Every session must have released its Menus first.
+
+    @param *source MenuSource to be freed
+  */
+void freeMenuSource( struct MenuSource *source ) {
+
+    if ( source->watching ) {
+        char stop = 0;
+        if ( write( source->stopPipe[ 1 ], &stop, 1 ) == 1 )
+            pthread_join( source->watcher, NULL );
+        close( source->stopPipe[ 0 ] );
+        close( source->stopPipe[ 1 ] );
+    }
+
+    freeMenu( source->current );
+    pthread_mutex_destroy( &source->lock );
+    statsFree( source );
+}
+
+/**
+    Takes a reference to the current Menu.
+
+    @param *source MenuSource to take the Menu from
+    @param *generation set to the generation of the Menu
+    @return the current Menu ( give it back with releaseMenu() )
+  */
+struct Menu *acquireMenu( struct MenuSource *source, int *generation ) {
+
+    pthread_mutex_lock( &source->lock );
+    struct Menu *menu = source->current;
+    menu->references++;
+    *generation = source->generation;
+    pthread_mutex_unlock( &source->lock );
+
+    return menu;
+}
+
+/**
+    Gives back a reference taken by acquireMenu(), freeing the Menu if it has
+    been replaced and nothing else refers to it.
+
+    @param *source MenuSource the Menu came from
+    @param *menu Menu to give back
+  */
+void releaseMenu( struct MenuSource *source, struct Menu *menu ) {
+
+    pthread_mutex_lock( &source->lock );
+    bool last = --menu->references == 0;
+    pthread_mutex_unlock( &source->lock );
+
+    if ( last )
+        freeMenu( menu );
+}
+
+/**
+    Reports the generation of the current Menu without locking, so sessions
+    can cheaply check whether it has been replaced.
+
+    @param *source MenuSource to check
+    @return the generation of the current Menu
+  */
+int menuGeneration( struct MenuSource *source ) {
+
+    return __atomic_load_n( &source->generation, __ATOMIC_ACQUIRE );
+}
+
+/**
+    Builds a new Menu from the source's files and makes it current. Runs on
+    the watcher thread; sessions keep using the old Menu until their next
+    command, and it is freed once the last of them lets go.
+
+    @param *source MenuSource to update
+  */
+static void reloadMenu( struct MenuSource *source ) {
+
+    struct Menu *menu = NULL;
+    int bad = 0;
+    int status;
+    long long start = statsStart();
+
+    if ( source->snapshot )
+        status = loadMenuSnapshot( source->filenames[ 0 ], &menu );
+    else {
+        // the files are being edited, and a mapped file cut short by the
+        // editor would take the whole server down with SIGBUS
+        menu = makeMenu();
+        status = readMenuFiles( source->filenames, source->fileCount, menu, &bad, false );
+        if ( status == MENU_OK )
+            sortMenuItems( menu );
+    }
+
+    if ( status != MENU_OK ) {
+        fprintf( stderr, status == MENU_CANT_OPEN ? "Can't open file: %s\n" :
+                 "Invalid menu file: %s\n", source->filenames[ bad ] );
+        if ( menu )
+            freeMenu( menu );
+        return;
+    }
+
+    statsStop( STATS_LOAD_MENU, start );
+    menu->references = 1;
+
+    pthread_mutex_lock( &source->lock );
+    struct Menu *old = source->current;
+    source->current = menu;
+    __atomic_store_n( &source->generation, source->generation + 1, __ATOMIC_RELEASE );
+    pthread_mutex_unlock( &source->lock );
+
+    releaseMenu( source, old );
+}
+
+/**
+    Checks whether an inotify event is about one of the source's files.
+
+    @param *source MenuSource whose files are watched
+    @param *dirs watch descriptor of each file's directory
+    @param *event event to check
+    @return true if the event names one of the files
+  */
+static bool isMenuFileEvent( struct MenuSource const *source, int const *dirs,
+                             struct inotify_event const *event ) {
+
+    if ( event->len == 0 )
+        return false;
+
+    for ( int i = 0; i < source->fileCount; i++ ) {
+
+        // basename() may change its argument
+        char *copy = strdup( source->filenames[ i ] );
+        bool match = dirs[ i ] == event->wd && strcmp( basename( copy ), event->name ) == 0;
+        free( copy );
+
+        if ( match )
+            return true;
+    }
+
+    return false;
+}
+
+/**
+    Argument for the watcher thread.
+  */
+struct Watch {
+    struct MenuSource *source; // MenuSource to update
+    int fd;                    // inotify instance
+    int *dirs;                 // watch descriptor of each file's directory
+};
+
+/**
+    Watcher thread: waits for the menu files to change and reloads the Menu,
+    until told to stop.
+
+    @param *arg the Watch ( freed by the thread )
+    @return NULL
+  */
+static void *watcher( void *arg ) {
+
+    struct Watch *watch = arg;
+    struct MenuSource *source = watch->source;
+    char buffer[ RELOAD_EVENT_BUFFER_SIZE ]
+        __attribute__ ( ( aligned( __alignof__( struct inotify_event ) ) ) );
+
+    struct pollfd fds[ 2 ] = {
+        { watch->fd, POLLIN, 0 },
+        { source->stopPipe[ 0 ], POLLIN, 0 },
+    };
+
+    bool changed = false;
+
+    while ( true ) {
+
+        // once something has changed, wait a little for the rest of the update
+        if ( poll( fds, 2, changed ? RELOAD_SETTLE_MS : -1 ) < 0 )
+            continue;
+
+        if ( fds[ 1 ].revents )
+            break;
+
+        if ( !fds[ 0 ].revents ) {
+            reloadMenu( source );
+            changed = false;
+            continue;
+        }
+
+        int n = read( watch->fd, buffer, sizeof( buffer ) );
+        for ( int pos = 0; pos < n; ) {
+            struct inotify_event const *event = (struct inotify_event const *) ( buffer + pos );
+            changed = changed || isMenuFileEvent( source, watch->dirs, event );
+            pos += sizeof( struct inotify_event ) + event->len;
+        }
+    }
+
+    close( watch->fd );
+    statsFree( watch->dirs );
+    statsFree( watch );
+    return NULL;
+}
+
+/**
+    Starts a thread that watches the given files with inotify and, whenever
+    one changes, builds a new Menu from them in the background and swaps it
+    in. If the files don't make a valid menu, the error is reported and the
+    current Menu is kept.
+
+    @param *source MenuSource to update
+    @param *filenames files to build the Menu from ( must outlive the source )
+    @param count number of files
+    @param snapshot true if the only file is a snapshot written by --compile
+    @return false if the files couldn't be watched
+  */
+bool watchMenuFiles( struct MenuSource *source, char *const *filenames, int count,
+                     bool snapshot ) {
+
+    source->filenames = filenames;
+    source->fileCount = count;
+    source->snapshot = snapshot;
+
+    struct Watch *watch = (struct Watch *) statsMalloc( sizeof( struct Watch ) );
+    watch->source = source;
+    watch->dirs = (int *) statsMalloc( count * sizeof( int ) );
+    watch->fd = inotify_init();
+
+    bool ok = watch->fd >= 0;
+
+    // watch the directories, since editors often replace a file rather than write to it
+    for ( int i = 0; i < count && ok; i++ ) {
+        char *copy = strdup( filenames[ i ] );
+        watch->dirs[ i ] = inotify_add_watch( watch->fd, dirname( copy ),
+                                              IN_CLOSE_WRITE | IN_MOVED_TO );
+        free( copy );
+        ok = watch->dirs[ i ] >= 0;
+    }
+
+    ok = ok && pipe( source->stopPipe ) == 0;
+
+    if ( ok && pthread_create( &source->watcher, NULL, watcher, watch ) != 0 ) {
+        close( source->stopPipe[ 0 ] );
+        close( source->stopPipe[ 1 ] );
+        ok = false;
+    }
+
+    if ( !ok ) {
+        if ( watch->fd >= 0 )
+            close( watch->fd );
+        statsFree( watch->dirs );
+        statsFree( watch );
+        return false;
+    }
+
+    source->watching = true;
+    return true;
+}
@@ -0,0 +1,94 @@
+/**
+    @filename reload.h
+    @author Will Greene (wgreene)
+
+    Header file for reload.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+struct Menu;
+
+/** how long to wait for more changes before reloading, in milliseconds */
+#define RELOAD_SETTLE_MS 100
+
+/** size of the buffer that inotify events are read into */
+#define RELOAD_EVENT_BUFFER_SIZE 4096
+
+/**
+    The Menu that new commands should use, and the thread that replaces it
+    when the menu files change. Every Menu handed out is reference counted,
+    so a replaced Menu stays in memory until the last session using it lets
+    go of it.
+  */
+struct MenuSource {
+    struct Menu *current;   // Menu handed to sessions ( the source holds a reference to it )
+    int generation;         // bumped every time current is replaced
+    pthread_mutex_t lock;   // guards current and the Menus' reference counts
+    char *const *filenames; // files the Menu is built from
+    int fileCount;          // number of files
+    bool snapshot;          // true if the only file is a snapshot written by --compile
+    bool watching;          // true while the watcher thread runs
+    int stopPipe[ 2 ];      // written to stop the watcher thread
+    pthread_t watcher;      // thread that reloads the Menu
+};
+
+/**
+    Allocates storage for a MenuSource that hands out the given Menu.
+
+    @param *menu Menu to start with ( owned by the source from now on )
+    @return the MenuSource
+  */
+struct MenuSource *makeMenuSource( struct Menu *menu );
+
+/**
+    Stops the watcher thread, if any, and frees the MenuSource and its
+    current Menu. Every session must have released its Menus first.
+
+    @param *source MenuSource to be freed
+  */
+void freeMenuSource( struct MenuSource *source );
+
+/**
+    Takes a reference to the current Menu.
+
+    @param *source MenuSource to take the Menu from
+    @param *generation set to the generation of the Menu
+    @return the current Menu ( give it back with releaseMenu() )
+  */
+struct Menu *acquireMenu( struct MenuSource *source, int *generation );
+
+/**
+    Gives back a reference taken by acquireMenu(), freeing the Menu if it has
+    been replaced and nothing else refers to it.
+
+    @param *source MenuSource the Menu came from
+    @param *menu Menu to give back
+  */
+void releaseMenu( struct MenuSource *source, struct Menu *menu );
+
+/**
+    Reports the generation of the current Menu without locking, so sessions
+    can cheaply check whether it has been replaced.
+
+    @param *source MenuSource to check
+    @return the generation of the current Menu
+  */
+int menuGeneration( struct MenuSource *source );
+
+/**
+    Starts a thread that watches the given files with inotify and, whenever
+    one changes, builds a new Menu from them in the background and swaps it
+    in. If the files don't make a valid menu, the error is reported and the
+    current Menu is kept.
+
+    @param *source MenuSource to update
+    @param *filenames files to build the Menu from ( must outlive the source )
+    @param count number of files
+    @param snapshot true if the only file is a snapshot written by --compile
+    @return false if the files couldn't be watched
+  */
+bool watchMenuFiles( struct MenuSource *source, char *const *filenames, int count,
+                     bool snapshot );
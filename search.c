@@ -0,0 +1,395 @@
+/**
+    @filename search.c
+    @author Will Greene (wgreene)
+
+    Finds MenuItems by part of their name, through a trigram index built once
+    the Menu is sorted, instead of a scan of every name.
+  */
+#include "menu.h"
+#include "search.h"
+#include "stats.h"
+#include "pool.h"
+#include "sort.h"
+
+#include <ctype.h>
+
+/** characters in a trigram */
+#define GRAM_LENGTH 3
+
+/**
+    Packs the trigram starting at the given character of a lowercased,
+    padded name. Keys of trigrams sharing a prefix form one range.
+
+    @param *p first character of the trigram
+    @return the packed trigram
+  */
+static unsigned int gramKey( unsigned char const *p ) {
+
+    return ( (unsigned int) p[ 0 ] << 16 ) | ( (unsigned int) p[ 1 ] << 8 ) | p[ 2 ];
+}
+
+/**
+    Lowercases a name and pads it with nulls so that its last characters
+    start trigrams too.
+
+    @param *name name to lowercase
+    @param *lower where to store it ( MAX_NUM_CHAR_NAME + GRAM_LENGTH - 1 characters )
+    @return the length of the name
+  */
+static int lowerName( char const *name, unsigned char *lower ) {
+
+    int length = 0;
+    for ( ; name[ length ]; length++ )
+        lower[ length ] = tolower( (unsigned char) name[ length ] );
+
+    for ( int i = 0; i < GRAM_LENGTH - 1; i++ )
+        lower[ length + i ] = '\0';
+
+    return length;
+}
+
+/**
+    Lists the distinct trigrams of a name.
+
+    @param *name name to split
+    @param *keys where to store the trigram keys ( MAX_NUM_CHAR_NAME entries )
+    @return the number of distinct trigrams
+  */
+static int nameGrams( char const *name, unsigned int *keys ) {
+
+    unsigned char lower[ MAX_NUM_CHAR_NAME + GRAM_LENGTH ];
+    int length = lowerName( name, lower );
+    int count = 0;
+
+    for ( int i = 0; i < length; i++ ) {
+
+        unsigned int key = gramKey( lower + i );
+
+        // names are short, so a linear check for repeats is cheapest
+        bool seen = false;
+        for ( int j = 0; j < count && !seen; j++ )
+            seen = keys[ j ] == key;
+
+        if ( !seen )
+            keys[ count++ ] = key;
+    }
+
+    return count;
+}
+
+/**
+    A trigram table used while indexing: trigram keys to their position in
+    the order they were first seen.
+  */
+struct GramTable {
+    unsigned int *keys; // trigram in each slot ( 0 if empty; no trigram packs to 0 )
+    int *ids;           // first-seen position of the trigram in each slot
+    int size;           // number of slots ( a power of 2 )
+    int count;          // number of trigrams
+};
+
+/**
+    Finds the slot of a trigram in the table, or the empty slot where it
+    would go.
+
+    @param *table GramTable to search
+    @param key packed trigram
+    @return the slot
+  */
+static int findGramSlot( struct GramTable const *table, unsigned int key ) {
+
+    unsigned int mask = table->size - 1;
+    unsigned int i = hashMenuItemKey( key ) & mask;
+
+    while ( table->keys[ i ] && table->keys[ i ] != key )
+        i = ( i + 1 ) & mask;
+
+    return i;
+}
+
+/**
+    Finds a trigram's first-seen position, adding it to the table if it's new.
+
+    @param *table GramTable to search
+    @param key packed trigram
+    @return the trigram's position
+  */
+static int internGram( struct GramTable *table, unsigned int key ) {
+
+    int slot = findGramSlot( table, key );
+    if ( table->keys[ slot ] )
+        return table->ids[ slot ];
+
+    table->keys[ slot ] = key;
+    table->ids[ slot ] = table->count++;
+
+    // keep the table at most half full
+    if ( table->count * 2 > table->size ) {
+
+        unsigned int *oldKeys = table->keys;
+        int *oldIds = table->ids;
+        int oldSize = table->size;
+
+        table->size *= 2;
+        table->keys = ( unsigned int * ) statsCalloc( table->size, sizeof( unsigned int ) );
+        table->ids = ( int * ) statsMalloc( table->size * sizeof( int ) );
+
+        for ( int i = 0; i < oldSize; i++ ) {
+            if ( oldKeys[ i ] ) {
+                int s = findGramSlot( table, oldKeys[ i ] );
+                table->keys[ s ] = oldKeys[ i ];
+                table->ids[ s ] = oldIds[ i ];
+            }
+        }
+
+        statsFree( oldKeys );
+        statsFree( oldIds );
+    }
+
+    return table->count - 1;
+}
+
+/**
+    Builds the name index of a sorted Menu: for every trigram of the
+    lowercased names ( padded at the end, so short queries are trigram
+    prefixes ), the sorted list of idView positions of the MenuItems whose
+    names contain it. Called by sortMenuItems().
+
+    @param *menu Menu to index ( menuView, idView and rows must be built )
+  */
+void indexMenuNames( struct Menu *menu ) {
+
+    struct GramTable table;
+    table.size = GRAM_TABLE_INITIAL_SIZE;
+    table.count = 0;
+    table.keys = ( unsigned int * ) statsCalloc( table.size, sizeof( unsigned int ) );
+    table.ids = ( int * ) statsMalloc( table.size * sizeof( int ) );
+
+    int capacity = GRAM_TABLE_INITIAL_SIZE;
+    int *counts = ( int * ) statsCalloc( capacity, sizeof( int ) );
+    unsigned int keys[ MAX_NUM_CHAR_NAME ];
+
+    // the trigram positions of every name, in idView order, so names are split only once
+    long long total = 0;
+    long long idCapacity = (long long) menu->count * GRAM_LENGTH + 1;
+    int *ids = ( int * ) statsMalloc( idCapacity * sizeof( int ) );
+    unsigned char *perName = ( unsigned char * ) statsMalloc( menu->count + 1 );
+
+    // count the names each trigram appears in
+    for ( int i = 0; i < menu->count; i++ ) {
+
+        int n = nameGrams( menu->items[ menu->idView[ i ] ].name, keys );
+        perName[ i ] = n;
+
+        if ( total + n > idCapacity ) {
+            idCapacity = idCapacity * 2 + MAX_NUM_CHAR_NAME;
+            ids = statsRealloc( ids, idCapacity * sizeof( int ) );
+        }
+
+        for ( int j = 0; j < n; j++ ) {
+            int id = internGram( &table, keys[ j ] );
+            if ( id >= capacity ) {
+                counts = statsRealloc( counts, capacity * 2 * sizeof( int ) );
+                memset( counts + capacity, 0, capacity * sizeof( int ) );
+                capacity *= 2;
+            }
+            counts[ id ]++;
+            ids[ total++ ] = id;
+        }
+    }
+
+    // sort the trigrams by key, so a prefix is one range of them
+    unsigned int *byId = ( unsigned int * ) statsMalloc( ( table.count + 1 ) *
+                         sizeof( unsigned int ) );
+    for ( int s = 0; s < table.size; s++ ) {
+        if ( table.keys[ s ] )
+            byId[ table.ids[ s ] ] = table.keys[ s ];
+    }
+
+    int *order = ( int * ) statsMalloc( ( table.count + 1 ) * sizeof( int ) );
+    unsigned long long *sortKeys = ( unsigned long long * ) statsMalloc( ( table.count + 1 ) *
+                                   sizeof( unsigned long long ) );
+    for ( int g = 0; g < table.count; g++ ) {
+        order[ g ] = g;
+        sortKeys[ g ] = byId[ g ];
+    }
+
+    radixSort( sortKeys, order, table.count );
+    statsFree( sortKeys );
+
+    statsFree( menu->gramKeys );
+    statsFree( menu->gramStart );
+    statsFree( menu->postings );
+    menu->gramCount = table.count;
+    menu->gramKeys = ( unsigned int * ) statsMalloc( ( table.count + 1 ) * sizeof( unsigned int ) );
+    menu->gramStart = ( int * ) statsMalloc( ( table.count + 1 ) * sizeof( int ) );
+    menu->postings = ( int * ) statsMalloc( ( total + 1 ) * sizeof( int ) );
+
+    // lay the posting lists out in key order; next[ id ] is where the next entry goes
+    int *next = ( int * ) statsMalloc( ( table.count + 1 ) * sizeof( int ) );
+    int start = 0;
+    for ( int g = 0; g < table.count; g++ ) {
+        menu->gramKeys[ g ] = byId[ order[ g ] ];
+        menu->gramStart[ g ] = start;
+        next[ order[ g ] ] = start;
+        start += counts[ order[ g ] ];
+    }
+    menu->gramStart[ table.count ] = start;
+
+    // fill them in idView order, so every list comes out sorted
+    long long k = 0;
+    for ( int i = 0; i < menu->count; i++ ) {
+        for ( int j = 0; j < perName[ i ]; j++ )
+            menu->postings[ next[ ids[ k++ ] ]++ ] = i;
+    }
+
+    statsFree( next );
+    statsFree( ids );
+    statsFree( perName );
+    statsFree( order );
+    statsFree( byId );
+    statsFree( counts );
+    statsFree( table.keys );
+    statsFree( table.ids );
+}
+
+/**
+    Finds the first trigram whose key is at least the given key.
+
+    @param *menu Menu to search
+    @param key packed trigram
+    @return its position in gramKeys ( gramCount if there is none )
+  */
+static int lowerBound( struct Menu const *menu, unsigned int key ) {
+
+    int lo = 0;
+    int hi = menu->gramCount;
+
+    while ( lo < hi ) {
+        int mid = ( lo + hi ) / 2;
+        if ( menu->gramKeys[ mid ] < key )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/**
+    Checks whether a name contains the given lowercased text, ignoring case.
+
+    @param *name name to check
+    @param *text lowercased text
+    @param length length of the text
+    @return true if the name contains the text
+  */
+static bool nameContains( char const *name, unsigned char const *text, int length ) {
+
+    for ( ; *name; name++ ) {
+        int i = 0;
+        while ( i < length && name[ i ] && tolower( (unsigned char) name[ i ] ) == text[ i ] )
+            i++;
+        if ( i == length )
+            return true;
+    }
+
+    return false;
+}
+
+/**
+    Prints the row of the MenuItem at the given idView position.
+
+    @param *menu Menu the MenuItem is in
+    @param rank idView position of the MenuItem
+    @param *out stream to print to
+  */
+static void printRow( struct Menu const *menu, int rank, FILE *out ) {
+
+    int row = menu->idRow[ rank ];
+    fwrite( menu->rows + menu->rowStart[ row ], 1,
+            menu->rowStart[ row + 1 ] - menu->rowStart[ row ], out );
+}
+
+/**
+    Prints the MenuItems whose names contain the given text, ignoring case,
+    sorted by id and formatted like a category listing ( header first, but
+    without the command, which the caller echoes ).
+
+    @param *menu Menu to search
+    @param *text text to look for ( null terminated )
+    @param *scratch Arena for temporary memory
+    @param *out stream to print to
+  */
+void findMenuItems( struct Menu const *menu, char const *text, struct Arena *scratch,
+                    FILE *out ) {
+
+    fputs( MENU_HEADER, out );
+
+    int length = strlen( text );
+    unsigned char lower[ MAX_NUM_CHAR_NAME + GRAM_LENGTH ];
+
+    if ( length >= MAX_NUM_CHAR_NAME || length == 0 ) {
+        putc( '\n', out );
+        return;
+    }
+
+    lowerName( text, lower );
+
+    if ( length >= GRAM_LENGTH ) {
+
+        // the rarest trigram of the text gives the fewest names to check
+        int best = -1;
+        for ( int i = 0; i + GRAM_LENGTH <= length; i++ ) {
+
+            int g = lowerBound( menu, gramKey( lower + i ) );
+            if ( g == menu->gramCount || menu->gramKeys[ g ] != gramKey( lower + i ) ) {
+                best = -1;
+                break;
+            }
+
+            if ( best < 0 || menu->gramStart[ g + 1 ] - menu->gramStart[ g ] <
+                             menu->gramStart[ best + 1 ] - menu->gramStart[ best ] )
+                best = g;
+        }
+
+        for ( int p = best < 0 ? 0 : menu->gramStart[ best ];
+              best >= 0 && p < menu->gramStart[ best + 1 ]; p++ ) {
+
+            int rank = menu->postings[ p ];
+            if ( length == GRAM_LENGTH ||
+                 nameContains( menu->items[ menu->idView[ rank ] ].name, lower, length ) )
+                printRow( menu, rank, out );
+        }
+
+    } else {
+
+        // shorter text: every trigram that starts with it
+        unsigned int shift = 8 * ( GRAM_LENGTH - length );
+        unsigned int low = gramKey( lower );
+        unsigned int high = low | ( ( 1u << shift ) - 1 );
+        int first = lowerBound( menu, low );
+        int last = lowerBound( menu, high + 1 );
+
+        if ( last - first == 1 ) {
+            for ( int p = menu->gramStart[ first ]; p < menu->gramStart[ last ]; p++ )
+                printRow( menu, menu->postings[ p ], out );
+        } else if ( last > first ) {
+
+            // a name can have several of the trigrams, so merge the lists through a bitmap
+            int words = ( menu->count + 63 ) / 64;
+            unsigned long long *seen = arenaAlloc( scratch, words * sizeof( unsigned long long ) );
+            memset( seen, 0, words * sizeof( unsigned long long ) );
+
+            for ( int p = menu->gramStart[ first ]; p < menu->gramStart[ last ]; p++ )
+                seen[ menu->postings[ p ] / 64 ] |= 1ULL << ( menu->postings[ p ] % 64 );
+
+            for ( int w = 0; w < words; w++ ) {
+                for ( unsigned long long bits = seen[ w ]; bits; bits &= bits - 1 )
+                    printRow( menu, w * 64 + __builtin_ctzll( bits ), out );
+            }
+        }
+    }
+
+    putc( '\n', out );
+}
@@ -0,0 +1,38 @@
+/**
+    @filename search.h
+    @author Will Greene (wgreene)
+
+    Header file for search.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+struct Menu;
+struct Arena;
+
+/** initial number of slots in the trigram table used while indexing ( a power of 2 ) */
+#define GRAM_TABLE_INITIAL_SIZE 1024
+
+/**
+    Builds the name index of a sorted Menu: for every trigram of the
+    lowercased names ( padded at the end, so short queries are trigram
+    prefixes ), the sorted list of idView positions of the MenuItems whose
+    names contain it. Called by sortMenuItems().
+
+    @param *menu Menu to index ( menuView, idView and rows must be built )
+  */
+void indexMenuNames( struct Menu *menu );
+
+/**
+    Prints the MenuItems whose names contain the given text, ignoring case,
+    sorted by id and formatted like a category listing ( header first, but
+    without the command, which the caller echoes ).
+
+    @param *menu Menu to search
+    @param *text text to look for ( null terminated )
+    @param *scratch Arena for temporary memory
+    @param *out stream to print to
+  */
+void findMenuItems( struct Menu const *menu, char const *text, struct Arena *scratch,
+                    FILE *out );
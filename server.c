@@ -0,0 +1,276 @@
+/**
+    @filename server.c
+    @author Will Greene (wgreene)
+
+    Serves many kiosk sessions from one process, sharing the current read-only
+    Menu across one thread per connection, and connects terminals to it.
+  */
+#include "input.h"
+#include "menu.h"
+#include "reload.h"
+#include "command.h"
+#include "server.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** size of the buffer runClient() copies through */
+#define CLIENT_BUFFER_SIZE 4096
+
+/**
+    State shared by every session thread. Sessions read the Menu without any
+    locking; only the session count is shared, and it is updated atomically.
+  */
+struct Server {
+    struct MenuSource *source;   // menu shared by every session
+    struct TicketQueue *tickets; // kitchen queue shared by every session
+    int sessions;                // number of sessions being served
+};
+
+/**
+    A connection handed to its session thread.
+  */
+struct Connection {
+    struct Server *server; // server the connection was accepted by
+    int fd;                // connected socket
+};
+
+/**
+    Runs one session on a connected socket, then closes it.
+
+    @param *source MenuSource to order from
+    @param *tickets TicketQueue to check Orders out to
+    @param fd connected socket
+  */
+static void serveConnection( struct MenuSource *source, struct TicketQueue *tickets, int fd ) {
+
+    // the output stream gets its own descriptor so closing it leaves fd alone
+    int outFd = dup( fd );
+    FILE *out = outFd < 0 ? NULL : fdopen( outFd, "w" );
+
+    if ( out ) {
+        struct LineReader *reader = makeLineReader( fd );
+        runSession( source, NULL, tickets, reader, out, true, true );
+        freeLineReader( reader );
+        fclose( out );
+    } else if ( outFd >= 0 ) {
+        close( outFd );
+    }
+
+    close( fd );
+}
+
+/**
+    Session thread: serves one connection, then lets another take its place.
+
+    @param *arg the Connection ( freed here )
+    @return NULL
+  */
+static void *sessionThread( void *arg ) {
+
+    struct Connection *connection = arg;
+    struct Server *server = connection->server;
+
+    serveConnection( server->source, server->tickets, connection->fd );
+
+    statsFree( connection );
+    __atomic_fetch_sub( &server->sessions, 1, __ATOMIC_RELEASE );
+    return NULL;
+}
+
+/**
+    Turns a connection away with a message, for when no session can be
+    started for it.
+
+    @param fd connected socket ( closed here )
+  */
+static void refuseConnection( int fd ) {
+
+    // a short reply to a socket nobody has written to yet can't block, and a
+    // peer that is already gone loses nothing if it fails
+    write( fd, SERVER_FULL, strlen( SERVER_FULL ) );
+    close( fd );
+}
+
+/**
+    Waits before accepting again, when accept() ran out of descriptors or
+    memory; retrying at once would only spin until a session ends.
+  */
+static void acceptBackoff( void ) {
+
+    struct timespec delay = { 0, SERVER_ACCEPT_BACKOFF_MS * 1000000L };
+    while ( nanosleep( &delay, &delay ) < 0 && errno == EINTR )
+        ;
+}
+
+/**
+    Serves kiosk sessions over a Unix-domain socket until the process is
+    stopped. Every connection is a session with its own Order, run on a
+    thread of its own. All sessions share the source's current Menu.
+
+    @param *source MenuSource to order from
+    @param *tickets TicketQueue shared by every session for checkouts
+    @param *path path of the socket to create
+    @return false if the socket couldn't be set up, or accepting failed
+  */
+bool runServer( struct MenuSource *source, struct TicketQueue *tickets, char const *path ) {
+
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+
+    if ( strlen( path ) >= sizeof( addr.sun_path ) )
+        return false;
+    strcpy( addr.sun_path, path );
+
+    int listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( listenFd < 0 )
+        return false;
+
+    unlink( path );
+    if ( bind( listenFd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 ||
+         listen( listenFd, SERVER_BACKLOG ) < 0 ) {
+        close( listenFd );
+        return false;
+    }
+
+    // a terminal hanging up mid-listing shouldn't take the server down
+    signal( SIGPIPE, SIG_IGN );
+
+    static struct Server server;
+    server.source = source;
+    server.tickets = tickets;
+    server.sessions = 0;
+
+    pthread_attr_t attr;
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+
+    while ( true ) {
+
+        int fd = accept( listenFd, NULL, NULL );
+
+        if ( fd < 0 ) {
+            if ( errno == EINTR || errno == ECONNABORTED )
+                continue;
+            if ( errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM ) {
+                acceptBackoff();
+                continue;
+            }
+            break;
+        }
+
+        if ( __atomic_load_n( &server.sessions, __ATOMIC_ACQUIRE ) >= SERVER_MAX_SESSIONS ) {
+            refuseConnection( fd );
+            continue;
+        }
+
+        struct Connection *connection = statsMalloc( sizeof( struct Connection ) );
+        connection->server = &server;
+        connection->fd = fd;
+
+        __atomic_fetch_add( &server.sessions, 1, __ATOMIC_RELAXED );
+
+        pthread_t thread;
+        if ( pthread_create( &thread, &attr, sessionThread, connection ) != 0 ) {
+            __atomic_fetch_sub( &server.sessions, 1, __ATOMIC_RELAXED );
+            statsFree( connection );
+            refuseConnection( fd );
+        }
+    }
+
+    pthread_attr_destroy( &attr );
+    close( listenFd );
+    return false;
+}
+
+/**
+    Client thread: copies standard input to the server, then tells it there
+    is no more.
+
+    @param *arg pointer to the connected socket
+    @return NULL
+  */
+static void *sendInput( void *arg ) {
+
+    int fd = *( int * ) arg;
+    char buffer[ CLIENT_BUFFER_SIZE ];
+    ssize_t n;
+
+    while ( ( n = read( STDIN_FILENO, buffer, sizeof( buffer ) ) ) != 0 ) {
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n < 0 )
+            break;
+
+        for ( ssize_t sent = 0, m; sent < n; sent += m ) {
+            if ( ( m = write( fd, buffer + sent, n - sent ) ) < 0 ) {
+                if ( errno != EINTR )
+                    return NULL;
+                m = 0;
+            }
+        }
+    }
+
+    shutdown( fd, SHUT_WR );
+    return NULL;
+}
+
+/**
+    Connects to a server started with runServer() and passes standard input
+    to it and its replies to standard output, until it hangs up.
+
+    @param *path path of the server's socket
+    @return false if the server couldn't be reached
+  */
+bool runClient( char const *path ) {
+
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+
+    if ( strlen( path ) >= sizeof( addr.sun_path ) )
+        return false;
+    strcpy( addr.sun_path, path );
+
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 )
+        return false;
+
+    if ( connect( fd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 ) {
+        close( fd );
+        return false;
+    }
+
+    // a server that hangs up early ends the session, not the process
+    signal( SIGPIPE, SIG_IGN );
+
+    pthread_t sender;
+    if ( pthread_create( &sender, NULL, sendInput, &fd ) != 0 ) {
+        close( fd );
+        return false;
+    }
+
+    char buffer[ CLIENT_BUFFER_SIZE ];
+    ssize_t n;
+
+    while ( ( n = read( fd, buffer, sizeof( buffer ) ) ) != 0 ) {
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n < 0 || fwrite( buffer, 1, n, stdout ) != (size_t) n )
+            break;
+        fflush( stdout );
+    }
+
+    // the server is gone, so whatever is left of the input has nowhere to go
+    pthread_cancel( sender );
+    pthread_join( sender, NULL );
+    close( fd );
+    return true;
+}
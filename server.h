@@ -0,0 +1,45 @@
+/**
+    @filename server.h
+    @author Will Greene (wgreene)
+
+    Header file for server.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+struct MenuSource;
+struct TicketQueue;
+
+/** most sessions served at once ( further connections are turned away ) */
+#define SERVER_MAX_SESSIONS 1024
+
+/** number of connections that can wait to be accepted */
+#define SERVER_BACKLOG 64
+
+/** milliseconds to wait before accepting again when out of descriptors or memory */
+#define SERVER_ACCEPT_BACKOFF_MS 100
+
+/** message sent to connections turned away */
+#define SERVER_FULL "The kiosk is full, try again later\n"
+
+/**
+    Serves kiosk sessions over a Unix-domain socket until the process is
+    stopped. Every connection is a session with its own Order, run on a
+    thread of its own. All sessions share the source's current Menu.
+
+    @param *source MenuSource to order from
+    @param *tickets TicketQueue shared by every session for checkouts
+    @param *path path of the socket to create
+    @return false if the socket couldn't be set up, or accepting failed
+  */
+bool runServer( struct MenuSource *source, struct TicketQueue *tickets, char const *path );
+
+/**
+    Connects to a server started with runServer() and passes standard input
+    to it and its replies to standard output, until it hangs up.
+
+    @param *path path of the server's socket
+    @return false if the server couldn't be reached
+  */
+bool runClient( char const *path );
@@ -0,0 +1,370 @@
+/**
+    @filename snapshot.c
+    @author Will Greene (wgreene)
+
+    Writes a fully built Menu to a binary snapshot file, and maps one back in
+    so the kiosk can start without parsing or sorting.
+  */
+#include "menu.h"
+#include "snapshot.h"
+#include "stats.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** sections of a snapshot, in file order */
+enum SnapshotSection {
+    SECTION_ITEMS,
+    SECTION_INDEX,
+    SECTION_MENU_VIEW,
+    SECTION_ID_VIEW,
+    SECTION_CATEGORIES,
+    SECTION_CATEGORY_INDEX,
+    SECTION_CATEGORY_START,
+    SECTION_ROW_START,
+    SECTION_ROWS,
+    SECTION_ID_ROW,
+    SECTION_COST_ROWS,
+    SECTION_CATEGORY_COST_ROWS,
+    SECTION_GRAM_KEYS,
+    SECTION_GRAM_START,
+    SECTION_POSTINGS,
+    SECTION_COUNT
+};
+
+/** alignment of every section in the file */
+#define SNAPSHOT_ALIGN 8
+
+/**
+    Start of a snapshot file.
+  */
+struct SnapshotHeader {
+    char magic[ 8 ];                   // SNAPSHOT_MAGIC ( not null terminated )
+    int version;                       // SNAPSHOT_VERSION
+    int itemSize;                      // sizeof( struct MenuItem ) when written
+    int count;                         // number of menu items
+    int indexSize;                     // number of slots in the id index
+    int categoryCount;                 // number of categories
+    int categoryIndexSize;             // number of slots in the category index
+    int gramCount;                     // number of trigrams in the name index
+    long long offset[ SECTION_COUNT ]; // where each section starts in the file
+    long long size[ SECTION_COUNT ];   // number of bytes in each section
+};
+
+/**
+    Lists where each section of a Menu lives in memory and how big it is.
+
+    @param *menu Menu to describe
+    @param *data filled in with the start of each section
+    @param *size filled in with the size of each section
+  */
+static void menuSections( struct Menu const *menu, void const *data[], long long size[] ) {
+
+    data[ SECTION_ITEMS ] = menu->items;
+    size[ SECTION_ITEMS ] = (long long) menu->count * sizeof( struct MenuItem );
+    data[ SECTION_INDEX ] = menu->index;
+    size[ SECTION_INDEX ] = (long long) menu->indexSize * sizeof( int );
+    data[ SECTION_MENU_VIEW ] = menu->menuView;
+    size[ SECTION_MENU_VIEW ] = (long long) menu->count * sizeof( int );
+    data[ SECTION_ID_VIEW ] = menu->idView;
+    size[ SECTION_ID_VIEW ] = (long long) menu->count * sizeof( int );
+    data[ SECTION_CATEGORIES ] = menu->categories;
+    size[ SECTION_CATEGORIES ] = (long long) menu->categoryCount * sizeof( menu->categories[ 0 ] );
+    data[ SECTION_CATEGORY_INDEX ] = menu->categoryIndex;
+    size[ SECTION_CATEGORY_INDEX ] = (long long) menu->categoryIndexSize * sizeof( int );
+    data[ SECTION_CATEGORY_START ] = menu->categoryStart;
+    size[ SECTION_CATEGORY_START ] = (long long) ( menu->categoryCount + 1 ) * sizeof( int );
+    data[ SECTION_ROW_START ] = menu->rowStart;
+    size[ SECTION_ROW_START ] = (long long) ( menu->count + 1 ) * sizeof( int );
+    data[ SECTION_ROWS ] = menu->rows;
+    size[ SECTION_ROWS ] = menu->rowStart[ menu->count ];
+    data[ SECTION_ID_ROW ] = menu->idRow;
+    size[ SECTION_ID_ROW ] = (long long) menu->count * sizeof( int );
+    data[ SECTION_COST_ROWS ] = menu->costRows;
+    size[ SECTION_COST_ROWS ] = (long long) menu->count * sizeof( int );
+    data[ SECTION_CATEGORY_COST_ROWS ] = menu->categoryCostRows;
+    size[ SECTION_CATEGORY_COST_ROWS ] = (long long) menu->count * sizeof( int );
+    data[ SECTION_GRAM_KEYS ] = menu->gramKeys;
+    size[ SECTION_GRAM_KEYS ] = (long long) menu->gramCount * sizeof( unsigned int );
+    data[ SECTION_GRAM_START ] = menu->gramStart;
+    size[ SECTION_GRAM_START ] = (long long) ( menu->gramCount + 1 ) * sizeof( int );
+    data[ SECTION_POSTINGS ] = menu->postings;
+    size[ SECTION_POSTINGS ] = (long long) menu->gramStart[ menu->gramCount ] * sizeof( int );
+}
+
+/**
+    Writes a sorted Menu to a binary snapshot file: the MenuItems in their
+    in-memory layout, followed by the id index, the sorted views, the
+    category table, the listing rows, the cost orders and the name index.
+    The file is written under a temporary name and renamed into place, so
+    readers never see half of it.
+
+    @param *menu Menu to write ( already sorted by sortMenuItems() )
+    @param *filename name of the snapshot file
+    @return true if the snapshot was written
+  */
+bool writeMenuSnapshot( struct Menu const *menu, char const *filename ) {
+
+    struct SnapshotHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, SNAPSHOT_MAGIC, sizeof( header.magic ) );
+    header.version = SNAPSHOT_VERSION;
+    header.itemSize = sizeof( struct MenuItem );
+    header.count = menu->count;
+    header.indexSize = menu->indexSize;
+    header.categoryCount = menu->categoryCount;
+    header.categoryIndexSize = menu->categoryIndexSize;
+    header.gramCount = menu->gramCount;
+
+    void const *data[ SECTION_COUNT ];
+    menuSections( menu, data, header.size );
+
+    long long offset = sizeof( header );
+    for ( int i = 0; i < SECTION_COUNT; i++ ) {
+        offset = ( offset + SNAPSHOT_ALIGN - 1 ) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+        header.offset[ i ] = offset;
+        offset += header.size[ i ];
+    }
+
+    char *tmpName = (char *) statsMalloc( strlen( filename ) + sizeof( ".tmp" ) );
+    strcpy( tmpName, filename );
+    strcat( tmpName, ".tmp" );
+
+    FILE *fp = fopen( tmpName, "wb" );
+    if ( !fp ) {
+        statsFree( tmpName );
+        return false;
+    }
+
+    static char const padding[ SNAPSHOT_ALIGN ];
+    bool ok = fwrite( &header, sizeof( header ), 1, fp ) == 1;
+    long long written = sizeof( header );
+
+    for ( int i = 0; i < SECTION_COUNT && ok; i++ ) {
+        ok = fwrite( padding, 1, header.offset[ i ] - written, fp ) ==
+             (size_t) ( header.offset[ i ] - written );
+        if ( ok && header.size[ i ] > 0 )
+            ok = fwrite( data[ i ], header.size[ i ], 1, fp ) == 1;
+        written = header.offset[ i ] + header.size[ i ];
+    }
+
+    ok = fclose( fp ) == 0 && ok;
+    ok = ok && rename( tmpName, filename ) == 0;
+    if ( !ok )
+        unlink( tmpName );
+
+    statsFree( tmpName );
+    return ok;
+}
+
+/**
+    Checks that every entry of a list of indexes is in range.
+
+    @param *list list to check
+    @param count number of entries in the list
+    @param limit every entry must be at least 0 and less than this
+    @return true if the entries are all in range
+  */
+static bool inRange( int const *list, int count, int limit ) {
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( list[ i ] < 0 || list[ i ] >= limit )
+            return false;
+    }
+
+    return true;
+}
+
+/**
+    Checks that a list of starts ( count + 1 entries ) begins at 0, never goes
+    backwards and ends at the given value.
+
+    @param *start list to check
+    @param count number of ranges the starts mark
+    @param end value of the last entry
+    @return true if the starts are well formed
+  */
+static bool ascending( int const *start, int count, int end ) {
+
+    if ( start[ 0 ] != 0 || start[ count ] != end )
+        return false;
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( start[ i ] > start[ i + 1 ] )
+            return false;
+    }
+
+    return true;
+}
+
+/**
+    Checks a hash table whose slots hold an index + 1, or 0 if empty. Its size
+    must be a power of two, and it must be at most half full so probing always
+    reaches an empty slot.
+
+    @param *table slots of the table
+    @param size number of slots
+    @param count number of entries the slots can refer to
+    @return true if the table is usable
+  */
+static bool validTable( int const *table, int size, int count ) {
+
+    if ( size <= 0 || ( size & ( size - 1 ) ) != 0 || size < 2LL * count ||
+         !inRange( table, size, count + 1 ) )
+        return false;
+
+    int used = 0;
+    for ( int i = 0; i < size; i++ )
+        used += table[ i ] != 0;
+
+    return used <= count;
+}
+
+/**
+    Checks that a string field is null terminated within its storage.
+
+    @param *field field to check
+    @param size number of bytes in the field
+    @return true if the field holds a string
+  */
+static bool terminated( char const *field, int size ) {
+
+    return memchr( field, '\0', size ) != NULL;
+}
+
+/**
+    Checks everything a mapped Menu stores, so a damaged or hostile snapshot
+    can't make lookups or listings read outside the mapping. The section sizes
+    must already agree with the counts.
+
+    @param *menu Menu pointing into the mapping
+    @return true if every stored index and offset is in range
+  */
+static bool validMenuSnapshot( struct Menu const *menu ) {
+
+    if ( !validTable( menu->index, menu->indexSize, menu->count ) ||
+         !validTable( menu->categoryIndex, menu->categoryIndexSize, menu->categoryCount ) )
+        return false;
+
+    for ( int i = 0; i < menu->count; i++ ) {
+        struct MenuItem const *item = &menu->items[ i ];
+        if ( !terminated( item->id, sizeof( item->id ) ) ||
+             !terminated( item->name, sizeof( item->name ) ) ||
+             !terminated( item->category, sizeof( item->category ) ) ||
+             item->categoryId < 0 || item->categoryId >= menu->categoryCount )
+            return false;
+    }
+
+    for ( int i = 0; i < menu->categoryCount; i++ ) {
+        if ( !terminated( menu->categories[ i ], sizeof( menu->categories[ i ] ) ) )
+            return false;
+    }
+
+    return inRange( menu->menuView, menu->count, menu->count ) &&
+           inRange( menu->idView, menu->count, menu->count ) &&
+           inRange( menu->idRow, menu->count, menu->count ) &&
+           inRange( menu->costRows, menu->count, menu->count ) &&
+           inRange( menu->categoryCostRows, menu->count, menu->count ) &&
+           inRange( menu->postings, menu->gramStart[ menu->gramCount ], menu->count ) &&
+           ascending( menu->categoryStart, menu->categoryCount, menu->count ) &&
+           ascending( menu->rowStart, menu->count, menu->rowStart[ menu->count ] ) &&
+           ascending( menu->gramStart, menu->gramCount, menu->gramStart[ menu->gramCount ] );
+}
+
+/**
+    Loads a Menu from a snapshot file by mapping it into memory. Nothing is
+    parsed or sorted; the Menu's arrays point straight into the mapping and
+    must not be changed.
+
+    @param *filename name of the snapshot file
+    @param **menu set to the loaded Menu ( free it with freeMenu() )
+    @return MENU_OK, MENU_CANT_OPEN, or MENU_INVALID if the file isn't a
+            snapshot this program can read
+  */
+int loadMenuSnapshot( char const *filename, struct Menu **menu ) {
+
+    int fd = open( filename, O_RDONLY );
+    if ( fd < 0 )
+        return MENU_CANT_OPEN;
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size < (off_t) sizeof( struct SnapshotHeader ) ) {
+        close( fd );
+        return MENU_INVALID;
+    }
+
+    char *base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( base == MAP_FAILED )
+        return MENU_INVALID;
+
+    struct SnapshotHeader const *header = (struct SnapshotHeader const *) base;
+    bool ok = memcmp( header->magic, SNAPSHOT_MAGIC, sizeof( header->magic ) ) == 0 &&
+              header->version == SNAPSHOT_VERSION &&
+              header->itemSize == sizeof( struct MenuItem );
+
+    for ( int i = 0; i < SECTION_COUNT && ok; i++ ) {
+        ok = header->offset[ i ] >= (long long) sizeof( *header ) && header->size[ i ] >= 0 &&
+             header->offset[ i ] % SNAPSHOT_ALIGN == 0 &&
+             header->offset[ i ] + header->size[ i ] <= st.st_size;
+    }
+
+    // the row and trigram starts give the sizes of the sections after them
+    long long intSize = (long long) sizeof( int );
+    ok = ok && header->count >= 0 && header->gramCount >= 0 && header->categoryCount >= 0 &&
+         header->size[ SECTION_ROW_START ] == ( header->count + 1LL ) * intSize &&
+         header->size[ SECTION_GRAM_START ] == ( header->gramCount + 1LL ) * intSize;
+
+    if ( !ok ) {
+        munmap( base, st.st_size );
+        return MENU_INVALID;
+    }
+
+    struct Menu *m = ( struct Menu * ) statsCalloc( 1, sizeof( struct Menu ) );
+    m->count = header->count;
+    m->capacity = header->count;
+    m->indexSize = header->indexSize;
+    m->categoryCount = header->categoryCount;
+    m->categoryCapacity = header->categoryCount;
+    m->categoryIndexSize = header->categoryIndexSize;
+    m->gramCount = header->gramCount;
+
+    m->items = (struct MenuItem *) ( base + header->offset[ SECTION_ITEMS ] );
+    m->index = (int *) ( base + header->offset[ SECTION_INDEX ] );
+    m->menuView = (int *) ( base + header->offset[ SECTION_MENU_VIEW ] );
+    m->idView = (int *) ( base + header->offset[ SECTION_ID_VIEW ] );
+    m->categories = (char ( * )[ MAX_NUM_CHAR_CATEGORY ]) ( base +
+                    header->offset[ SECTION_CATEGORIES ] );
+    m->categoryIndex = (int *) ( base + header->offset[ SECTION_CATEGORY_INDEX ] );
+    m->categoryStart = (int *) ( base + header->offset[ SECTION_CATEGORY_START ] );
+    m->rowStart = (int *) ( base + header->offset[ SECTION_ROW_START ] );
+    m->rows = base + header->offset[ SECTION_ROWS ];
+    m->idRow = (int *) ( base + header->offset[ SECTION_ID_ROW ] );
+    m->costRows = (int *) ( base + header->offset[ SECTION_COST_ROWS ] );
+    m->categoryCostRows = (int *) ( base + header->offset[ SECTION_CATEGORY_COST_ROWS ] );
+    m->gramKeys = (unsigned int *) ( base + header->offset[ SECTION_GRAM_KEYS ] );
+    m->gramStart = (int *) ( base + header->offset[ SECTION_GRAM_START ] );
+    m->postings = (int *) ( base + header->offset[ SECTION_POSTINGS ] );
+
+    // make sure the counts in the header agree with the section sizes
+    void const *data[ SECTION_COUNT ];
+    long long size[ SECTION_COUNT ];
+    menuSections( m, data, size );
+
+    for ( int i = 0; i < SECTION_COUNT && ok; i++ )
+        ok = size[ i ] == header->size[ i ];
+
+    if ( !ok || !validMenuSnapshot( m ) ) {
+        statsFree( m );
+        munmap( base, st.st_size );
+        return MENU_INVALID;
+    }
+
+    m->snapshot = base;
+    m->snapshotSize = st.st_size;
+
+    *menu = m;
+    return MENU_OK;
+}
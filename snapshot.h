@@ -0,0 +1,42 @@
+/**
+    @filename snapshot.h
+    @author Will Greene (wgreene)
+
+    Header file for snapshot.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+struct Menu;
+
+/** first bytes of every menu snapshot file */
+#define SNAPSHOT_MAGIC "KIOSKSNP"
+
+/** version of the snapshot layout ( bumped whenever struct Menu's arrays change ) */
+#define SNAPSHOT_VERSION 3
+
+/**
+    Writes a sorted Menu to a binary snapshot file: the MenuItems in their
+    in-memory layout, followed by the id index, the sorted views, the
+    category table, the listing rows, the cost orders and the name index.
+    The file is written under a temporary name and renamed into place, so
+    readers never see half of it.
+
+    @param *menu Menu to write ( already sorted by sortMenuItems() )
+    @param *filename name of the snapshot file
+    @return true if the snapshot was written
+  */
+bool writeMenuSnapshot( struct Menu const *menu, char const *filename );
+
+/**
+    Loads a Menu from a snapshot file by mapping it into memory. Nothing is
+    parsed or sorted; the Menu's arrays point straight into the mapping and
+    must not be changed.
+
+    @param *filename name of the snapshot file
+    @param **menu set to the loaded Menu ( free it with freeMenu() )
+    @return MENU_OK, MENU_CANT_OPEN, or MENU_INVALID if the file isn't a
+            snapshot this program can read
+  */
+int loadMenuSnapshot( char const *filename, struct Menu **menu );
@@ -0,0 +1,90 @@
+/**
+    @filename sort.c
+    @author Will Greene (wgreene)
+
+    Sorts values by packed integer keys without comparisons.
+  */
+#include "sort.h"
+#include "stats.h"
+
+#include <string.h>
+
+/** number of RADIX_BITS digits in a 64-bit key */
+#define RADIX_DIGITS ( 64 / RADIX_BITS )
+
+/**
+    Sorts values by 64-bit keys, smallest key first, with a least significant
+    digit radix sort. The sort is stable, so sorting by one key and then
+    another orders by the second key, then the first. Passes over digits
+    that every key shares are skipped, so small keys cost only the passes
+    their bits need.
+
+    @param *keys sort key of each value ( sorted along with the values )
+    @param *values values to sort
+    @param count number of values
+  */
+void radixSort( unsigned long long *keys, int *values, int count ) {
+
+    if ( count < 2 )
+        return;
+
+    // count every digit of every key in one read of the keys
+    int ( *counts )[ RADIX_BUCKETS ] = statsCalloc( RADIX_DIGITS, sizeof( *counts ) );
+
+    for ( int i = 0; i < count; i++ ) {
+        unsigned long long key = keys[ i ];
+        for ( int d = 0; d < RADIX_DIGITS; d++ )
+            counts[ d ][ ( key >> ( d * RADIX_BITS ) ) & ( RADIX_BUCKETS - 1 ) ]++;
+    }
+
+    unsigned long long *keyBuffer = NULL;
+    int *valueBuffer = NULL;
+    unsigned long long *fromKeys = keys;
+    int *fromValues = values;
+
+    for ( int d = 0; d < RADIX_DIGITS; d++ ) {
+
+        int shift = d * RADIX_BITS;
+
+        // every key has the same digit here, so this pass wouldn't move anything
+        if ( counts[ d ][ ( keys[ 0 ] >> shift ) & ( RADIX_BUCKETS - 1 ) ] == count )
+            continue;
+
+        if ( !keyBuffer ) {
+            keyBuffer = ( unsigned long long * ) statsMalloc( count *
+                        sizeof( unsigned long long ) );
+            valueBuffer = ( int * ) statsMalloc( count * sizeof( int ) );
+        }
+
+        unsigned long long *toKeys = fromKeys == keys ? keyBuffer : keys;
+        int *toValues = fromValues == values ? valueBuffer : values;
+
+        // where each bucket starts
+        int next[ RADIX_BUCKETS ];
+        int sum = 0;
+        for ( int b = 0; b < RADIX_BUCKETS; b++ ) {
+            next[ b ] = sum;
+            sum += counts[ d ][ b ];
+        }
+
+        for ( int i = 0; i < count; i++ ) {
+            int b = ( fromKeys[ i ] >> shift ) & ( RADIX_BUCKETS - 1 );
+            toKeys[ next[ b ] ] = fromKeys[ i ];
+            toValues[ next[ b ] ] = fromValues[ i ];
+            next[ b ]++;
+        }
+
+        fromKeys = toKeys;
+        fromValues = toValues;
+    }
+
+    // an odd number of passes leaves the result in the buffers
+    if ( fromKeys != keys ) {
+        memcpy( keys, fromKeys, count * sizeof( unsigned long long ) );
+        memcpy( values, fromValues, count * sizeof( int ) );
+    }
+
+    statsFree( keyBuffer );
+    statsFree( valueBuffer );
+    statsFree( counts );
+}
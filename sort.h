@@ -0,0 +1,28 @@
+/**
+    @filename sort.h
+    @author Will Greene (wgreene)
+
+    Header file for sort.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/** number of key bits sorted by each pass of radixSort() */
+#define RADIX_BITS 8
+
+/** number of buckets in each pass of radixSort() ( 2 ^ RADIX_BITS ) */
+#define RADIX_BUCKETS 256
+
+/**
+    Sorts values by 64-bit keys, smallest key first, with a least significant
+    digit radix sort. The sort is stable, so sorting by one key and then
+    another orders by the second key, then the first. Passes over digits
+    that every key shares are skipped, so small keys cost only the passes
+    their bits need.
+
+    @param *keys sort key of each value ( sorted along with the values )
+    @param *values values to sort
+    @param count number of values
+  */
+void radixSort( unsigned long long *keys, int *values, int count );
@@ -0,0 +1,222 @@
+/**
+    @filename stats.c
+    @author Will Greene (wgreene)
+
+    Counts and times commands and other operations, and counts memory
+    allocations. Everything is a relaxed atomic, so server sessions can
+    record at the same time; when statistics are off, each hook is a single
+    test of a flag.
+  */
+#include "stats.h"
+
+#include <time.h>
+
+/** nanoseconds in a second */
+#define NANOS_PER_SECOND 1000000000LL
+
+/** nanoseconds in a microsecond */
+#define NANOS_PER_MICRO 1000.0
+
+/**
+    Count, time and latency histogram of one counter.
+  */
+struct Stat {
+    long long count;                      // number of occurrences
+    long long nanos;                      // total time taken
+    long long maxNanos;                   // longest occurrence
+    long long buckets[ STATS_BUCKETS ];   // occurrences by the bit length of their time
+};
+
+/** names of the counters in the report */
+static char const *statNames[ STATS_COUNTER_COUNT ] = {
+    "list menu", "list category", "list order", "list price", "list cheapest",
+    "add", "remove", "order", "checkout", "find", "stats", "quit", "invalid",
+    "load menu", "listMenuItems", "listOrderItems", "listPriceRange", "listCheapest",
+    "journal sync",
+};
+
+/** true once statistics are being collected ( set before any threads start ) */
+bool statsEnabled = false;
+
+/** every counter */
+static struct Stat stats[ STATS_COUNTER_COUNT ];
+
+/** allocation calls, and bytes requested from malloc, calloc and realloc */
+static long long mallocCalls;
+static long long callocCalls;
+static long long reallocCalls;
+static long long freeCalls;
+static long long allocatedBytes;
+
+/**
+    Reads the monotonic clock, if statistics are being collected.
+
+    @return the time in nanoseconds, or 0 if statistics are off
+  */
+long long statsStart() {
+
+    if ( !statsEnabled )
+        return 0;
+
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * NANOS_PER_SECOND + ts.tv_nsec;
+}
+
+/**
+    Records one occurrence of a counter that started at the given time.
+
+    @param counter what happened
+    @param start time it started ( from statsStart() )
+  */
+void statsStop( enum StatsCounter counter, long long start ) {
+
+    if ( !statsEnabled )
+        return;
+
+    long long nanos = statsStart() - start;
+    struct Stat *stat = &stats[ counter ];
+
+    // bucket b holds times of b bits: [ 2 ^ ( b - 1 ), 2 ^ b )
+    int bucket = nanos > 0 ? 64 - __builtin_clzll( nanos ) : 0;
+    if ( bucket >= STATS_BUCKETS )
+        bucket = STATS_BUCKETS - 1;
+
+    __atomic_fetch_add( &stat->count, 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &stat->nanos, nanos, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &stat->buckets[ bucket ], 1, __ATOMIC_RELAXED );
+
+    long long max = __atomic_load_n( &stat->maxNanos, __ATOMIC_RELAXED );
+    while ( nanos > max && !__atomic_compare_exchange_n( &stat->maxNanos, &max, nanos, true,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+        ;
+}
+
+/**
+    Allocates memory like malloc(), counting the call.
+
+    @param size number of bytes
+    @return the memory
+  */
+void *statsMalloc( size_t size ) {
+
+    if ( statsEnabled ) {
+        __atomic_fetch_add( &mallocCalls, 1, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &allocatedBytes, size, __ATOMIC_RELAXED );
+    }
+
+    return malloc( size );
+}
+
+/**
+    Allocates zeroed memory like calloc(), counting the call.
+
+    @param count number of elements
+    @param size size of each element
+    @return the memory
+  */
+void *statsCalloc( size_t count, size_t size ) {
+
+    if ( statsEnabled ) {
+        __atomic_fetch_add( &callocCalls, 1, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &allocatedBytes, count * size, __ATOMIC_RELAXED );
+    }
+
+    return calloc( count, size );
+}
+
+/**
+    Resizes memory like realloc(), counting the call.
+
+    @param *ptr memory to resize ( may be NULL )
+    @param size new number of bytes
+    @return the memory
+  */
+void *statsRealloc( void *ptr, size_t size ) {
+
+    if ( statsEnabled ) {
+        __atomic_fetch_add( &reallocCalls, 1, __ATOMIC_RELAXED );
+        __atomic_fetch_add( &allocatedBytes, size, __ATOMIC_RELAXED );
+    }
+
+    return realloc( ptr, size );
+}
+
+/**
+    Frees memory like free(), counting the call.
+
+    @param *ptr memory to free ( may be NULL )
+  */
+void statsFree( void *ptr ) {
+
+    if ( statsEnabled && ptr )
+        __atomic_fetch_add( &freeCalls, 1, __ATOMIC_RELAXED );
+
+    free( ptr );
+}
+
+/**
+    Estimates a percentile from a histogram, as the upper end of the bucket
+    it falls in.
+
+    @param *stat counter to look at
+    @param count number of occurrences of the counter ( at least 1 )
+    @param percent percentile to find ( 0 to 100 )
+    @return the latency in microseconds
+  */
+static double percentile( struct Stat const *stat, long long count, double percent ) {
+
+    long long rank = (long long) ( percent / 100.0 * count + 0.5 );
+    if ( rank < 1 )
+        rank = 1;
+
+    long long seen = 0;
+    for ( int b = 0; b < STATS_BUCKETS; b++ ) {
+        seen += __atomic_load_n( &stat->buckets[ b ], __ATOMIC_RELAXED );
+        if ( seen >= rank ) {
+            long long upper = b == 0 ? 0 : ( 1LL << b ) - 1;
+            long long max = __atomic_load_n( &stat->maxNanos, __ATOMIC_RELAXED );
+            return ( upper < max ? upper : max ) / NANOS_PER_MICRO;
+        }
+    }
+
+    return __atomic_load_n( &stat->maxNanos, __ATOMIC_RELAXED ) / NANOS_PER_MICRO;
+}
+
+/**
+    Prints every counter's count and latency percentiles, followed by the
+    allocation counts.
+
+    @param *out stream to print to
+  */
+void printStats( FILE *out ) {
+
+    if ( !statsEnabled ) {
+        fputs( "Statistics are off ( start the kiosk with --stats )\n\n", out );
+        return;
+    }
+
+    fputs( "Operation          Count      Mean us       p50 us"
+           "       p90 us       p99 us       Max us\n", out );
+
+    for ( int i = 0; i < STATS_COUNTER_COUNT; i++ ) {
+
+        struct Stat const *stat = &stats[ i ];
+        long long count = __atomic_load_n( &stat->count, __ATOMIC_RELAXED );
+        if ( count == 0 )
+            continue;
+
+        long long nanos = __atomic_load_n( &stat->nanos, __ATOMIC_RELAXED );
+        fprintf( out, "%-15s%9lld %12.2f %12.2f %12.2f %12.2f %12.2f\n", statNames[ i ], count,
+                 nanos / NANOS_PER_MICRO / count, percentile( stat, count, 50 ),
+                 percentile( stat, count, 90 ), percentile( stat, count, 99 ),
+                 __atomic_load_n( &stat->maxNanos, __ATOMIC_RELAXED ) / NANOS_PER_MICRO );
+    }
+
+    fprintf( out, "Allocations: malloc %lld calloc %lld realloc %lld free %lld bytes %lld\n\n",
+             __atomic_load_n( &mallocCalls, __ATOMIC_RELAXED ),
+             __atomic_load_n( &callocCalls, __ATOMIC_RELAXED ),
+             __atomic_load_n( &reallocCalls, __ATOMIC_RELAXED ),
+             __atomic_load_n( &freeCalls, __ATOMIC_RELAXED ),
+             __atomic_load_n( &allocatedBytes, __ATOMIC_RELAXED ) );
+}
@@ -0,0 +1,97 @@
+/**
+    @filename stats.h
+    @author Will Greene (wgreene)
+
+    Header file for stats.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/** number of latency histogram buckets ( one per power of 2 nanoseconds ) */
+#define STATS_BUCKETS 64
+
+/**
+    Things that are counted and timed.
+  */
+enum StatsCounter {
+    STATS_LIST_MENU,     // "list menu" commands
+    STATS_LIST_CATEGORY, // "list category" commands
+    STATS_LIST_ORDER,    // "list order" commands
+    STATS_LIST_PRICE,    // "list price" commands
+    STATS_LIST_CHEAPEST, // "list cheapest" commands
+    STATS_ADD,           // "add" commands
+    STATS_REMOVE,        // "remove" commands
+    STATS_ORDER,         // "order" commands
+    STATS_CHECKOUT,      // "checkout" commands
+    STATS_FIND,          // "find" commands
+    STATS_STATS,         // "stats" commands
+    STATS_QUIT,          // "quit" commands
+    STATS_INVALID,       // invalid commands
+    STATS_LOAD_MENU,     // loading the menu files ( readMenuItems() and sorting )
+    STATS_LIST_MENU_ITEMS,   // listMenuItems() calls
+    STATS_LIST_ORDER_ITEMS,  // listOrderItems() calls
+    STATS_LIST_PRICE_RANGE,  // listPriceRange() calls
+    STATS_LIST_CHEAPEST_ITEMS, // listCheapest() calls
+    STATS_JOURNAL_SYNC,      // syncing the order journal to disk
+    STATS_COUNTER_COUNT
+};
+
+/** true once statistics are being collected ( set before any threads start ) */
+extern bool statsEnabled;
+
+/**
+    Reads the monotonic clock, if statistics are being collected.
+
+    @return the time in nanoseconds, or 0 if statistics are off
+  */
+long long statsStart();
+
+/**
+    Records one occurrence of a counter that started at the given time.
+
+    @param counter what happened
+    @param start time it started ( from statsStart() )
+  */
+void statsStop( enum StatsCounter counter, long long start );
+
+/**
+    Allocates memory like malloc(), counting the call.
+
+    @param size number of bytes
+    @return the memory
+  */
+void *statsMalloc( size_t size );
+
+/**
+    Allocates zeroed memory like calloc(), counting the call.
+
+    @param count number of elements
+    @param size size of each element
+    @return the memory
+  */
+void *statsCalloc( size_t count, size_t size );
+
+/**
+    Resizes memory like realloc(), counting the call.
+
+    @param *ptr memory to resize ( may be NULL )
+    @param size new number of bytes
+    @return the memory
+  */
+void *statsRealloc( void *ptr, size_t size );
+
+/**
+    Frees memory like free(), counting the call.
+
+    @param *ptr memory to free ( may be NULL )
+  */
+void statsFree( void *ptr );
+
+/**
+    Prints every counter's count and latency percentiles, followed by the
+    allocation counts.
+
+    @param *out stream to print to
+  */
+void printStats( FILE *out );
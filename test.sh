@@ -109,6 +109,62 @@ if [ -x kiosk ] ; then
     args=(menu-h.txt)
     runTest 20 1
  
+    args=(--batch menu-b.txt menu-c.txt)
+    runTest 21 0
+ 
+    args=(--script input-07.txt --script input-08.txt menu-b.txt menu-c.txt)
+    runTest 22 0
+ 
+    ./kiosk --compile menu.snap menu-b.txt menu-c.txt
+    args=(--snapshot menu.snap)
+    runTest 23 0
+ 
+    args=(menu-b.txt menu-c.txt)
+    runTest 24 0
+ 
+    args=(menu-b.txt menu-c.txt)
+    runTest 25 0
+ 
+    args=(menu-b.txt menu-c.txt)
+    runTest 26 0
+ 
+    args=(--check menu-a.txt menu-i.txt menu-e.txt)
+    runTest 27 1
+ 
+    args=(menu-b.txt menu-c.txt)
+    runTest 28 0
+ 
+    rm -f kiosk.jnl
+    printf 'add 1897 2\nadd 3045 1\nremove 1897 1\n' |
+        ./kiosk --batch --journal kiosk.jnl menu-b.txt menu-c.txt > /dev/null
+    args=(--journal kiosk.jnl menu-b.txt menu-c.txt)
+    runTest 29 0
+ 
+    args=(menu-b.txt menu-c.txt)
+    runTest 30 0
+ 
+    args=(--tickets /dev/stderr menu-b.txt menu-c.txt)
+    runTest 31 0
+ 
+    # more terminals than a pool of 32 workers could serve, all holding their
+    # sessions open until kiosk.fifo is closed
+    rm -f kiosk.sock kiosk.fifo
+    mkfifo kiosk.fifo
+    exec 3<> kiosk.fifo
+    ./kiosk --server kiosk.sock menu-b.txt menu-c.txt > /dev/null &
+    server=$!
+    while [ ! -S kiosk.sock ]; do sleep 0.1; done
+    for i in $(seq 40); do
+        ./kiosk --connect kiosk.sock < kiosk.fifo > /dev/null &
+    done
+    sleep 0.5
+    args=(--connect kiosk.sock)
+    runTest 32 0
+    exec 3>&-
+    kill $server
+    wait
+    rm -f kiosk.sock kiosk.fifo
+ 
 else
     echo "**** Your program couldn't be tested since it didn't compile successfully."
     FAIL=1
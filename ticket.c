@@ -0,0 +1,325 @@
+/**
+    @filename ticket.c
+    @author Will Greene (wgreene)
+
+    Freezes checked-out Orders into kitchen tickets, and hands them to a
+    kitchen thread through a lock-free queue.
+  */
+#include "menu.h"
+#include "order.h"
+#include "ticket.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+/**
+    One line of a kitchen ticket, copied out of the Order so it doesn't
+    depend on the Menu staying around.
+  */
+struct TicketLine {
+    char id[ NUM_CHAR_ID ];                 // id of the MenuItem
+    char name[ MAX_NUM_CHAR_NAME ];         // name of the MenuItem
+    char category[ MAX_NUM_CHAR_CATEGORY ]; // category of the MenuItem
+    int quantity;                           // how many were ordered
+    long long cost;                         // cost of the line ( cost * quantity ) in cents
+};
+
+/**
+    A checked-out Order, frozen for the kitchen. It isn't changed once it's
+    been pushed onto a TicketQueue.
+  */
+struct Ticket {
+    long long number;          // ticket number ( from 1, in the order tickets were queued )
+    int order;                 // number of the Order in its session
+    int count;                 // number of lines
+    long long total;           // total cost of the Order in cents
+    struct TicketLine lines[]; // the Order's items, in listing order
+};
+
+/**
+    Freezes an Order into a ticket, copying everything the kitchen needs.
+
+    @param *order Order to freeze ( must have at least one item )
+    @param number number of the Order in its session
+    @return the Ticket ( freed by the kitchen thread once it's printed )
+  */
+struct Ticket *makeTicket( struct Order const *order, int number ) {
+
+    struct Ticket *ticket = ( struct Ticket * ) statsMalloc( sizeof( struct Ticket ) +
+                            order->count * sizeof( struct TicketLine ) );
+
+    ticket->number = 0;
+    ticket->order = number;
+    ticket->count = order->count;
+    ticket->total = order->total;
+
+    for ( int i = 0; i < order->count; i++ ) {
+        struct OrderItem const *orderItem = order->list[ i ];
+        struct TicketLine *line = &ticket->lines[ i ];
+        strcpy( line->id, orderItem->menuItem->id );
+        strcpy( line->name, orderItem->menuItem->name );
+        strcpy( line->category, orderItem->menuItem->category );
+        line->quantity = orderItem->quantity;
+        line->cost = (long long) orderItem->menuItem->cost * orderItem->quantity;
+    }
+
+    return ticket;
+}
+
+/**
+    Prints a ticket in one go, so nothing else printed to the same stream
+    lands in the middle of it.
+
+    @param *ticket Ticket to print
+    @param *out stream to print to
+  */
+static void printTicket( struct Ticket const *ticket, FILE *out ) {
+
+    flockfile( out );
+
+    fprintf( out, "Ticket %lld ( order %d )\n", ticket->number, ticket->order );
+    fprintf( out, "ID   Name                 Quantity Category        Cost\n" );
+
+    for ( int i = 0; i < ticket->count; i++ ) {
+        struct TicketLine const *line = &ticket->lines[ i ];
+        fprintf( out, "%-5s%-21s%8d %-16s$%3lld.%02lld\n", line->id, line->name,
+                 line->quantity, line->category, line->cost / CENTS_PER_DOLLAR,
+                 line->cost % CENTS_PER_DOLLAR );
+    }
+
+    fprintf( out, "Total                                              $%3lld.%02lld\n\n",
+             ticket->total / CENTS_PER_DOLLAR, ticket->total % CENTS_PER_DOLLAR );
+
+    funlockfile( out );
+}
+
+/**
+    Takes the oldest ticket off the queue. Only the kitchen thread calls this.
+
+    @param *queue TicketQueue to pop from
+    @return the Ticket, or NULL if there isn't one ready ( the queue is
+            empty, or the producer that claimed the next slot hasn't
+            finished filling it )
+  */
+static struct Ticket *popTicket( struct TicketQueue *queue ) {
+
+    unsigned long long pos = queue->dequeuePos;
+    struct TicketSlot *slot = &queue->slots[ pos & ( TICKET_QUEUE_SIZE - 1 ) ];
+
+    if ( __atomic_load_n( &slot->sequence, __ATOMIC_ACQUIRE ) != pos + 1 )
+        return NULL;
+
+    struct Ticket *ticket = slot->ticket;
+
+    // hand the slot back to producers for their next lap of the ring
+    __atomic_store_n( &slot->sequence, pos + TICKET_QUEUE_SIZE, __ATOMIC_RELEASE );
+    __atomic_store_n( &queue->dequeuePos, pos + 1, __ATOMIC_RELEASE );
+
+    return ticket;
+}
+
+/**
+    Kitchen thread: sleeps until a ticket is pushed, then prints it. Stops
+    once it's told to and every ticket has been printed.
+
+    @param *arg the TicketQueue
+    @return NULL
+  */
+static void *kitchen( void *arg ) {
+
+    struct TicketQueue *queue = arg;
+
+    // a post taken by sem_trywait() below, still owed its ticket
+    bool posted = false;
+    int unflushed = 0;
+
+    while ( true ) {
+
+        while ( !posted && sem_wait( &queue->ready ) != 0 )
+            ;
+        posted = false;
+
+        // every post but the last one to stop is for a ticket that has been published
+        struct Ticket *ticket;
+        while ( !( ticket = popTicket( queue ) ) ) {
+            if ( __atomic_load_n( &queue->stopping, __ATOMIC_ACQUIRE ) )
+                return NULL;
+            sched_yield();
+        }
+
+        long long number = ticket->number;
+        printTicket( ticket, queue->out );
+        statsFree( ticket );
+        __atomic_fetch_add( &queue->written, 1, __ATOMIC_RELAXED );
+
+        // flush once no more tickets are waiting, or every so often if they
+        // never stop coming, rather than after every ticket of a burst
+        posted = sem_trywait( &queue->ready ) == 0;
+        if ( !posted || ++unflushed >= TICKET_FLUSH_TICKETS ) {
+            fflush( queue->out );
+            __atomic_store_n( &queue->flushed, number, __ATOMIC_RELEASE );
+            unflushed = 0;
+        }
+    }
+}
+
+/**
+    Allocates storage for a TicketQueue and starts its kitchen thread.
+
+    @param *out stream to print tickets to
+    @return the TicketQueue, or NULL if the thread couldn't be started
+  */
+struct TicketQueue *makeTicketQueue( FILE *out ) {
+
+    struct TicketQueue *queue =
+        ( struct TicketQueue * ) statsMalloc( sizeof( struct TicketQueue ) );
+
+    queue->slots = ( struct TicketSlot * ) statsMalloc( TICKET_QUEUE_SIZE *
+                   sizeof( struct TicketSlot ) );
+    for ( unsigned long long i = 0; i < TICKET_QUEUE_SIZE; i++ ) {
+        queue->slots[ i ].sequence = i;
+        queue->slots[ i ].ticket = NULL;
+    }
+
+    queue->enqueuePos = 0;
+    queue->dequeuePos = 0;
+    queue->dropped = 0;
+    queue->written = 0;
+    queue->flushed = 0;
+    queue->peak = 0;
+    queue->stopping = false;
+    queue->out = out;
+    sem_init( &queue->ready, 0, 0 );
+
+    if ( pthread_create( &queue->kitchen, NULL, kitchen, queue ) != 0 ) {
+        sem_destroy( &queue->ready );
+        statsFree( queue->slots );
+        statsFree( queue );
+        return NULL;
+    }
+
+    return queue;
+}
+
+/**
+    Lets the kitchen thread print every ticket still waiting, then stops it.
+    No session may push tickets any more.
+
+    @param *queue TicketQueue to stop
+  */
+void stopTicketQueue( struct TicketQueue *queue ) {
+
+    __atomic_store_n( &queue->stopping, true, __ATOMIC_RELEASE );
+    sem_post( &queue->ready );
+    pthread_join( queue->kitchen, NULL );
+    fflush( queue->out );
+}
+
+/**
+    Frees the memory used to store the given TicketQueue. Its kitchen
+    thread must have been stopped first.
+
+    @param *queue TicketQueue to be freed
+  */
+void freeTicketQueue( struct TicketQueue *queue ) {
+
+    sem_destroy( &queue->ready );
+    statsFree( queue->slots );
+    statsFree( queue );
+}
+
+/**
+    Queues a ticket for the kitchen, without ever waiting for it.
+
+    @param *queue TicketQueue to push onto
+    @param *ticket Ticket to push ( owned by the queue if it's accepted )
+    @return the ticket's number, or 0 if the ring was full
+  */
+long long pushTicket( struct TicketQueue *queue, struct Ticket *ticket ) {
+
+    unsigned long long pos = __atomic_load_n( &queue->enqueuePos, __ATOMIC_RELAXED );
+    struct TicketSlot *slot;
+
+    // claim a position whose slot has been emptied, racing other producers for it
+    while ( true ) {
+
+        slot = &queue->slots[ pos & ( TICKET_QUEUE_SIZE - 1 ) ];
+        unsigned long long sequence = __atomic_load_n( &slot->sequence, __ATOMIC_ACQUIRE );
+        long long diff = ( long long ) ( sequence - pos );
+
+        if ( diff == 0 ) {
+            if ( __atomic_compare_exchange_n( &queue->enqueuePos, &pos, pos + 1, true,
+                                              __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+                break;
+        } else if ( diff < 0 ) {
+            // the slot still holds a ticket from the last lap: the ring is full
+            __atomic_fetch_add( &queue->dropped, 1, __ATOMIC_RELAXED );
+            return 0;
+        } else {
+            pos = __atomic_load_n( &queue->enqueuePos, __ATOMIC_RELAXED );
+        }
+    }
+
+    // measured before publishing, while the kitchen can't have taken this ticket yet
+    long long depth = pos + 1 - __atomic_load_n( &queue->dequeuePos, __ATOMIC_ACQUIRE );
+    long long peak = __atomic_load_n( &queue->peak, __ATOMIC_RELAXED );
+    while ( depth > peak && !__atomic_compare_exchange_n( &queue->peak, &peak, depth, true,
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+        ;
+
+    ticket->number = pos + 1;
+    slot->ticket = ticket;
+    __atomic_store_n( &slot->sequence, pos + 1, __ATOMIC_RELEASE );
+    sem_post( &queue->ready );
+
+    return pos + 1;
+}
+
+/**
+    Finds how far the kitchen has got. Tickets are written in number order,
+    so every ticket up to the one returned is out of the process.
+
+    @param *queue TicketQueue to check
+    @return the number of the last ticket written out ( 0 if none has been )
+  */
+long long ticketsWritten( struct TicketQueue *queue ) {
+
+    return __atomic_load_n( &queue->flushed, __ATOMIC_ACQUIRE );
+}
+
+/**
+    Waits until the kitchen has written out the ticket with the given number.
+
+    @param *queue TicketQueue the ticket was pushed onto
+    @param number number of the ticket
+  */
+void waitForTicket( struct TicketQueue *queue, long long number ) {
+
+    // the kitchen doesn't signal anyone, and this only happens as a session ends
+    while ( ticketsWritten( queue ) < number ) {
+        struct timespec delay = { 0, TICKET_WAIT_NANOS };
+        while ( nanosleep( &delay, &delay ) < 0 && errno == EINTR )
+            ;
+    }
+}
+
+/**
+    Prints how many tickets have been queued, printed and dropped, and how
+    many are waiting now and at most.
+
+    @param *queue TicketQueue to report on
+    @param *out stream to print to
+  */
+void printTicketStats( struct TicketQueue *queue, FILE *out ) {
+
+    long long queued = __atomic_load_n( &queue->enqueuePos, __ATOMIC_ACQUIRE );
+    long long dequeued = __atomic_load_n( &queue->dequeuePos, __ATOMIC_ACQUIRE );
+    long long depth = queued - dequeued;
+
+    fprintf( out, "Tickets: queued %lld printed %lld dropped %lld waiting %lld peak %lld\n\n",
+             queued, __atomic_load_n( &queue->written, __ATOMIC_RELAXED ),
+             __atomic_load_n( &queue->dropped, __ATOMIC_RELAXED ), depth < 0 ? 0 : depth,
+             __atomic_load_n( &queue->peak, __ATOMIC_RELAXED ) );
+}
@@ -0,0 +1,126 @@
+/**
+    @filename ticket.h
+    @author Will Greene (wgreene)
+
+    Header file for ticket.c
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+struct Order;
+struct Ticket;
+
+/** number of tickets that can wait for the kitchen ( a power of 2 ) */
+#define TICKET_QUEUE_SIZE 1024
+
+/** most tickets printed between flushes while more keep arriving */
+#define TICKET_FLUSH_TICKETS 64
+
+/** nanoseconds between checks while waiting for the kitchen to write a ticket */
+#define TICKET_WAIT_NANOS 1000000L
+
+/** bytes between fields written by different threads, so they don't share a cache line */
+#define TICKET_CACHE_LINE 64
+
+/**
+    One slot of a TicketQueue's ring. The sequence number says whose turn
+    the slot is: a producer may fill it when it equals the producer's
+    position, and the consumer may empty it when it is one more.
+  */
+struct TicketSlot {
+    unsigned long long sequence; // turn of the slot
+    struct Ticket *ticket;       // ticket in the slot, once filled
+};
+
+/**
+    A bounded, lock-free queue of tickets from any number of sessions to one
+    kitchen thread, which prints them. Pushing never waits: when the ring is
+    full the ticket is refused and counted as dropped.
+  */
+struct TicketQueue {
+    struct TicketSlot *slots;          // the ring ( TICKET_QUEUE_SIZE slots )
+    char pad0[ TICKET_CACHE_LINE ];
+    unsigned long long enqueuePos;     // next position producers will claim
+    char pad1[ TICKET_CACHE_LINE ];
+    unsigned long long dequeuePos;     // next position the consumer will empty
+    char pad2[ TICKET_CACHE_LINE ];
+    long long dropped;                 // tickets refused because the ring was full
+    long long written;                 // tickets printed by the kitchen thread
+    long long flushed;                 // number of the last ticket flushed to the stream
+    long long peak;                    // most tickets that have waited at once
+    sem_t ready;                       // posted once per ticket pushed ( and to stop )
+    bool stopping;                     // set to stop the kitchen thread once it's drained
+    FILE *out;                         // where tickets are printed
+    pthread_t kitchen;                 // thread that prints the tickets
+};
+
+/**
+    Freezes an Order into a ticket, copying everything the kitchen needs.
+
+    @param *order Order to freeze ( must have at least one item )
+    @param number number of the Order in its session
+    @return the Ticket ( freed by the kitchen thread once it's printed )
+  */
+struct Ticket *makeTicket( struct Order const *order, int number );
+
+/**
+    Allocates storage for a TicketQueue and starts its kitchen thread.
+
+    @param *out stream to print tickets to
+    @return the TicketQueue, or NULL if the thread couldn't be started
+  */
+struct TicketQueue *makeTicketQueue( FILE *out );
+
+/**
+    Lets the kitchen thread print every ticket still waiting, then stops it.
+    No session may push tickets any more.
+
+    @param *queue TicketQueue to stop
+  */
+void stopTicketQueue( struct TicketQueue *queue );
+
+/**
+    Frees the memory used to store the given TicketQueue. Its kitchen
+    thread must have been stopped first.
+
+    @param *queue TicketQueue to be freed
+  */
+void freeTicketQueue( struct TicketQueue *queue );
+
+/**
+    Queues a ticket for the kitchen, without ever waiting for it.
+
+    @param *queue TicketQueue to push onto
+    @param *ticket Ticket to push ( owned by the queue if it's accepted )
+    @return the ticket's number, or 0 if the ring was full
+  */
+long long pushTicket( struct TicketQueue *queue, struct Ticket *ticket );
+
+/**
+    Finds how far the kitchen has got. Tickets are written in number order,
+    so every ticket up to the one returned is out of the process.
+
+    @param *queue TicketQueue to check
+    @return the number of the last ticket written out ( 0 if none has been )
+  */
+long long ticketsWritten( struct TicketQueue *queue );
+
+/**
+    Waits until the kitchen has written out the ticket with the given number.
+
+    @param *queue TicketQueue the ticket was pushed onto
+    @param number number of the ticket
+  */
+void waitForTicket( struct TicketQueue *queue, long long number );
+
+/**
+    Prints how many tickets have been queued, printed and dropped, and how
+    many are waiting now and at most.
+
+    @param *queue TicketQueue to report on
+    @param *out stream to print to
+  */
+void printTicketStats( struct TicketQueue *queue, FILE *out );